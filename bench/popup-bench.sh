@@ -0,0 +1,26 @@
+#!/bin/sh
+#
+# Times the group popup with 10, 100 and 500 windows in one group, inside a running
+# session. The plugin logs the results, so the panel has to run with debug messages:
+#   xfce4-panel -q; G_MESSAGES_DEBUG=all xfce4-panel 2>&1 | grep 'Popup bench' &
+# Each round opens its windows with the class "docklike-bench", which needs xterm.
+
+set -e
+
+for count in 10 100 500; do
+	pids=""
+	i=0
+	while [ "$i" -lt "$count" ]; do
+		xterm -class docklike-bench -geometry 40x10 -e sleep 600 &
+		pids="$pids $!"
+		i=$((i + 1))
+	done
+
+	# let the windows map and the dock group them
+	sleep $((2 + count / 50))
+	xfce4-panel --plugin-event=docklike:bench-popup
+
+	sleep 2
+	kill $pids
+	wait $pids 2>/dev/null || true
+done
@@ -0,0 +1,127 @@
+/*
+ * Copyright (c) 2019-2020 Nicolas Szabo <nszabo@vivaldi.net>
+ * Copyright (c) 2020-2021 David Keogh <davidtkeogh@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Compares the single pass preview scaler against the gdk-pixbuf pipeline it replaced:
+// gdk_pixbuf_scale_simple(), then a composite into a padded pixbuf, then a cairo surface.
+// Run with `meson test --benchmark -C <builddir> --verbose`.
+
+#include "Scaler.hpp"
+
+#include <algorithm>
+#include <vector>
+
+static const int mIterations = 50;
+
+static GdkPixbuf* createSource(int width, int height)
+{
+	GdkPixbuf* pixbuf = gdk_pixbuf_new(GDK_COLORSPACE_RGB, true, 8, width, height);
+	guint8* pixels = gdk_pixbuf_get_pixels(pixbuf);
+	int stride = gdk_pixbuf_get_rowstride(pixbuf);
+
+	// something less uniform than a fill, so that no path gets away with shortcuts
+	for (int y = 0; y < height; ++y)
+		for (int x = 0; x < width; ++x)
+		{
+			guint8* p = pixels + y * stride + 4 * x;
+			p[0] = x * 7 + y;
+			p[1] = x ^ y;
+			p[2] = y * 3;
+			p[3] = 255;
+		}
+
+	return pixbuf;
+}
+
+static gint64 median(std::vector<gint64>& times)
+{
+	std::sort(times.begin(), times.end());
+	return times[times.size() / 2];
+}
+
+static gint64 benchPixbuf(GdkPixbuf* source, int previewWidth, int previewHeight)
+{
+	int width = gdk_pixbuf_get_width(source);
+	int height = gdk_pixbuf_get_height(source);
+	double ratio = MIN((double)previewWidth / width, (double)previewHeight / height);
+	int thumbWidth = MAX(1, width * ratio);
+	int thumbHeight = MAX(1, height * ratio);
+	std::vector<gint64> times;
+
+	for (int i = 0; i < mIterations; ++i)
+	{
+		gint64 start = g_get_monotonic_time();
+
+		GdkPixbuf* thumbnail = gdk_pixbuf_scale_simple(source, thumbWidth, thumbHeight, GDK_INTERP_BILINEAR);
+		GdkPixbuf* sized = gdk_pixbuf_new(GDK_COLORSPACE_RGB, true, 8, previewWidth, previewHeight);
+		int xOffset = (previewWidth - thumbWidth) / 2;
+		int yOffset = (previewHeight - thumbHeight) / 2;
+		gdk_pixbuf_composite(thumbnail, sized, xOffset, yOffset, thumbWidth, thumbHeight, xOffset, yOffset, 1, 1, GDK_INTERP_BILINEAR, 255);
+		cairo_surface_t* surface = gdk_cairo_surface_create_from_pixbuf(sized, 1, nullptr);
+
+		times.push_back(g_get_monotonic_time() - start);
+
+		cairo_surface_destroy(surface);
+		g_object_unref(sized);
+		g_object_unref(thumbnail);
+	}
+
+	return median(times);
+}
+
+static gint64 benchScaler(GdkPixbuf* source, int previewWidth, int previewHeight)
+{
+	cairo_surface_t* target = cairo_image_surface_create(CAIRO_FORMAT_ARGB32, previewWidth, previewHeight);
+	std::vector<gint64> times;
+
+	for (int i = 0; i < mIterations; ++i)
+	{
+		gint64 start = g_get_monotonic_time();
+
+		Scaler::scaleToFit(gdk_pixbuf_read_pixels(source), Scaler::FORMAT_RGBA,
+			gdk_pixbuf_get_width(source), gdk_pixbuf_get_height(source), gdk_pixbuf_get_rowstride(source), target);
+
+		times.push_back(g_get_monotonic_time() - start);
+	}
+
+	cairo_surface_destroy(target);
+	return median(times);
+}
+
+int main(int argc, char** argv)
+{
+	const int sizes[][2] = {{1280, 720}, {1920, 1080}, {3840, 2160}};
+	// the default preview size, see Settings::defPreviewWidth
+	const int previewWidth = 288;
+	const int previewHeight = 162;
+
+	g_print("# %s scaler, median of %d runs, %dx%d preview\n", Scaler::implementation(), mIterations, previewWidth, previewHeight);
+	g_print("# source\tgdk-pixbuf us\tscaler us\tspeedup\n");
+
+	for (const auto& size : sizes)
+	{
+		GdkPixbuf* source = createSource(size[0], size[1]);
+		gint64 pixbuf = benchPixbuf(source, previewWidth, previewHeight);
+		gint64 scaler = benchScaler(source, previewWidth, previewHeight);
+
+		g_print("%dx%d\t%" G_GINT64_FORMAT "\t%" G_GINT64_FORMAT "\t%.1fx\n",
+			size[0], size[1], pixbuf, scaler, scaler > 0 ? (double)pixbuf / scaler : 0.0);
+		g_object_unref(source);
+	}
+
+	return 0;
+}
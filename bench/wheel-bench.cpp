@@ -0,0 +1,127 @@
+/*
+ * Copyright (c) 2019-2020 Nicolas Szabo <nszabo@vivaldi.net>
+ * Copyright (c) 2020-2021 David Keogh <davidtkeogh@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Counts the main loop wakeups of timers with staggered periods: one GSource per timer, as
+// every Help::Gtk::Timeout used to be, against the shared timer wheel with its default slack.
+// Run with `meson test --benchmark -C <builddir> --verbose`.
+
+#include "Audit.hpp"
+#include "Helpers.hpp"
+
+#include <vector>
+
+// the plugin's accounting is not linked in
+void Audit::record(Kind kind, const char* origin, int line, gint64 duration) {}
+
+static const guint mDuration = 10000;
+
+static guint mPolls = 0;
+static guint mCallbacks = 0;
+
+// every wakeup of the main loop ends a poll
+static gint countPoll(GPollFD* fds, guint nfds, gint timeout)
+{
+	++mPolls;
+	return g_poll(fds, nfds, timeout);
+}
+
+static void run()
+{
+	GMainLoop* loop = g_main_loop_new(nullptr, false);
+	g_timeout_add(mDuration, G_SOURCE_FUNC(+[](gpointer loop) {
+		g_main_loop_quit((GMainLoop*)loop);
+		return G_SOURCE_REMOVE;
+	}),
+		loop);
+
+	mPolls = mCallbacks = 0;
+	g_main_loop_run(loop);
+	g_main_loop_unref(loop);
+}
+
+static uint period(int i)
+{
+	// from 100 ms up to 7.5 s for 200 timers, so that few of them are ever due together
+	return 100 + 37 * i;
+}
+
+static void benchSources(int count)
+{
+	std::vector<guint> ids;
+
+	for (int i = 0; i < count; ++i)
+		ids.push_back(g_timeout_add(period(i), G_SOURCE_FUNC(+[](gpointer) {
+			++mCallbacks;
+			return G_SOURCE_CONTINUE;
+		}),
+			nullptr));
+
+	run();
+
+	for (guint id : ids)
+		g_source_remove(id);
+}
+
+static void benchWheel(int count)
+{
+	std::vector<Help::Gtk::Timeout*> timeouts;
+
+	for (int i = 0; i < count; ++i)
+	{
+		Help::Gtk::Timeout* timeout = new Help::Gtk::Timeout();
+		timeout->setup(period(i), []() {
+			++mCallbacks;
+			return true;
+		});
+		timeout->start();
+		timeouts.push_back(timeout);
+	}
+
+	run();
+
+	for (Help::Gtk::Timeout* timeout : timeouts)
+		delete timeout;
+}
+
+int main(int argc, char** argv)
+{
+	const int counts[] = {10, 50, 200};
+
+	g_main_context_set_poll_func(nullptr, countPoll);
+
+	g_print("# %u ms per run, periods of 100 ms + 37 ms per timer\n", mDuration);
+	g_print("# timers\tsources wakeups/s\tsources callbacks\twheel wakeups/s\twheel callbacks\treduction\n");
+
+	for (int count : counts)
+	{
+		benchSources(count);
+		guint sourcePolls = mPolls;
+		guint sourceCallbacks = mCallbacks;
+
+		benchWheel(count);
+		guint wheelPolls = mPolls;
+		guint wheelCallbacks = mCallbacks;
+
+		g_print("%d\t%.1f\t%u\t%.1f\t%u\t%.1fx\n", count,
+			sourcePolls * 1000.0 / mDuration, sourceCallbacks,
+			wheelPolls * 1000.0 / mDuration, wheelCallbacks,
+			wheelPolls > 0 ? (double)sourcePolls / wheelPolls : 0.0);
+	}
+
+	return 0;
+}
@@ -18,6 +18,7 @@
 
 #include "AppInfos.hpp"
 #include "Settings.hpp"
+#include "Trace.hpp"
 
 #include <libxfce4ui/libxfce4ui.h>
 
@@ -78,6 +79,13 @@ namespace AppInfos
 	Store::Map<const std::string, std::shared_ptr<AppInfo>> mAppInfoUserSet;
 	Store::AutoPtr<GAppInfoMonitor> mMonitor;
 
+	// A reload scans one directory per job slice into these, and swaps them in once all are
+	// done, so that lookups meanwhile still see the complete previous tables.
+	Store::Map<const std::string, std::shared_ptr<AppInfo>> mStagedIds;
+	Store::Map<const std::string, std::shared_ptr<AppInfo>> mStagedNames;
+	Store::Map<const std::string, std::shared_ptr<AppInfo>> mStagedWMClasses;
+	std::list<std::string>::iterator mReloadDir;
+
 	static void findXDGDirectories()
 	{
 		std::unordered_set<std::string> dir_set;
@@ -125,14 +133,17 @@ namespace AppInfos
 		// clang-format on
 	};
 
-	static void loadDesktopEntry(const std::string& xdgDir, const std::string& filename)
+	static void loadDesktopEntry(const std::string& xdgDir, const std::string& filename,
+		Store::Map<const std::string, std::shared_ptr<AppInfo>>& ids,
+		Store::Map<const std::string, std::shared_ptr<AppInfo>>& names,
+		Store::Map<const std::string, std::shared_ptr<AppInfo>>& wmClasses)
 	{
 		if (!g_str_has_suffix(filename.c_str(), ".desktop"))
 			return;
 
 		std::string id = Help::String::pathBasename(filename, true);
 		std::string lower_id = Help::String::toLowercase(id);
-		if (mAppInfoIds.get(lower_id) != nullptr)
+		if (ids.get(lower_id) != nullptr)
 			return;
 
 		std::string path = xdgDir + filename;
@@ -149,7 +160,7 @@ namespace AppInfos
 		g_free(icon_);
 
 		std::shared_ptr<AppInfo> info = std::make_shared<AppInfo>(id, path, icon, name, gAppInfo);
-		mAppInfoIds.set(lower_id, info);
+		ids.set(lower_id, info);
 
 		name_ = g_desktop_app_info_get_string(gAppInfo, "Name");
 		name = (name_ != nullptr) ? name_ : "";
@@ -161,7 +172,7 @@ namespace AppInfos
 
 			if (name.find(' ') == std::string::npos)
 				if (name != lower_id)
-					mAppInfoNames.set(name, info);
+					names.set(name, info);
 		}
 
 		std::string exec;
@@ -172,7 +183,7 @@ namespace AppInfos
 			exec = Help::String::getWord(execLine, 0);
 
 			if (exec != lower_id && exec != name && mExcludedBinaries.find(exec) == mExcludedBinaries.end())
-				mAppInfoNames.set(exec, info);
+				names.set(exec, info);
 		}
 		g_free(exec_);
 
@@ -181,31 +192,57 @@ namespace AppInfos
 		if (wmclass_ != nullptr && wmclass_[0] != '\0')
 		{
 			wmclass = Help::String::toLowercase(Help::String::trim(wmclass_));
-			mAppInfoWMClasses.set(wmclass, info);
+			wmClasses.set(wmclass, info);
 		}
 		g_free(wmclass_);
 	}
 
+	static void loadXDGDirectory(const std::string& xdgDir,
+		Store::Map<const std::string, std::shared_ptr<AppInfo>>& ids,
+		Store::Map<const std::string, std::shared_ptr<AppInfo>>& names,
+		Store::Map<const std::string, std::shared_ptr<AppInfo>>& wmClasses)
+	{
+		DIR* directory = opendir(xdgDir.c_str());
+		if (directory == nullptr)
+			return;
+
+		struct dirent* entry;
+		while ((entry = readdir(directory)) != nullptr)
+			loadDesktopEntry(xdgDir, entry->d_name, ids, names, wmClasses);
+
+		closedir(directory);
+		g_debug("APPDIR: %s", xdgDir.c_str());
+	}
+
 	static void loadXDGDirectories()
 	{
 		for (const std::string& xdgDir : mXdgDataDirs)
+			loadXDGDirectory(xdgDir, mAppInfoIds, mAppInfoNames, mAppInfoWMClasses);
+	}
+
+	static bool reloadSlice()
+	{
+		if (mReloadDir != mXdgDataDirs.end())
 		{
-			DIR* directory = opendir(xdgDir.c_str());
-			if (directory == nullptr)
-				continue;
+			loadXDGDirectory(*mReloadDir++, mStagedIds, mStagedNames, mStagedWMClasses);
+			return true;
+		}
 
-			struct dirent* entry;
-			while ((entry = readdir(directory)) != nullptr)
-				loadDesktopEntry(xdgDir, entry->d_name);
+		mAppInfoIds.swap(mStagedIds);
+		mAppInfoNames.swap(mStagedNames);
+		mAppInfoWMClasses.swap(mStagedWMClasses);
+		mStagedIds.clear();
+		mStagedNames.clear();
+		mStagedWMClasses.clear();
 
-			closedir(directory);
-			g_debug("APPDIR: %s", xdgDir.c_str());
-		}
+		Dock::queueDrawGroups();
+		return false;
 	}
 
 	static bool addUserSetApp(const std::string& classId, const std::string& filename)
 	{
-		loadDesktopEntry(Help::String::pathDirname(filename), Help::String::pathBasename(filename));
+		loadDesktopEntry(Help::String::pathDirname(filename), Help::String::pathBasename(filename),
+			mAppInfoIds, mAppInfoNames, mAppInfoWMClasses);
 
 		std::string id = Help::String::toLowercase(Help::String::pathBasename(filename, true));
 		std::shared_ptr<AppInfo> info = mAppInfoIds.get(id);
@@ -226,11 +263,13 @@ namespace AppInfos
 
 		g_signal_connect(G_OBJECT(mMonitor.get()), "changed",
 			G_CALLBACK(+[](GAppInfoMonitor* monitor) {
-				mAppInfoIds.clear();
-				mAppInfoNames.clear();
-				mAppInfoWMClasses.clear();
-				loadXDGDirectories();
-				Dock::drawGroups();
+				// package operations emit this once per file, one reload covers them all,
+				// and starts over when they come in while it runs
+				mStagedIds.clear();
+				mStagedNames.clear();
+				mStagedWMClasses.clear();
+				mReloadDir = mXdgDataDirs.begin();
+				Help::Gtk::queueJob(&mMonitor, Help::Gtk::JOB_NORMAL, reloadSlice);
 			}),
 			nullptr);
 
@@ -249,6 +288,10 @@ namespace AppInfos
 
 	void finalize()
 	{
+		Help::Gtk::cancelJob(&mMonitor);
+		mStagedIds.clear();
+		mStagedNames.clear();
+		mStagedWMClasses.clear();
 		mXdgDataDirs.clear();
 		mAppInfoWMClasses.clear();
 		mAppInfoIds.clear();
@@ -300,6 +343,7 @@ namespace AppInfos
 
 	std::shared_ptr<AppInfo> search(std::string id)
 	{
+		TRACE_SPAN("AppInfos::search");
 		translateId(id);
 
 		g_debug("Searching a match for '%s'", id.c_str());
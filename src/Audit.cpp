@@ -0,0 +1,131 @@
+/*
+ * Copyright (c) 2019-2020 Nicolas Szabo <nszabo@vivaldi.net>
+ * Copyright (c) 2020-2021 David Keogh <davidtkeogh@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "Audit.hpp"
+#include "Helpers.hpp"
+#include "Plugin.hpp"
+#include "Trace.hpp"
+
+#include <glib/gstdio.h>
+
+#include <map>
+#include <tuple>
+#include <vector>
+
+namespace Audit
+{
+	struct Entry
+	{
+		uint count;
+		gint64 total;
+		gint64 max;
+	};
+
+	const char* const mKindNames[] = {"timeout", "idle", "signal", "dbus"};
+
+	// keyed by pointer, each translation unit has a single __builtin_FILE() string
+	std::map<std::tuple<Kind, const char*, int>, Entry> mEntries;
+	gint64 mStartTime = g_get_monotonic_time();
+
+	void record(Kind kind, const char* origin, int line, gint64 duration)
+	{
+		Entry& entry = mEntries[std::make_tuple(kind, origin, line)];
+		++entry.count;
+		entry.total += duration;
+		entry.max = std::max(entry.max, duration);
+
+#ifdef ENABLE_TRACE
+		Trace::complete(origin, line, g_get_monotonic_time() - duration, duration);
+#endif
+	}
+
+	Scope::Scope(Kind kind, const char* origin, int line) : mKind(kind), mOrigin(origin), mLine(line), mStart(g_get_monotonic_time()) {}
+
+	Scope::~Scope()
+	{
+		record(mKind, mOrigin, mLine, g_get_monotonic_time() - mStart);
+	}
+
+	std::string report()
+	{
+		std::vector<std::pair<std::string, Entry>> rows;
+		for (const auto& it : mEntries)
+		{
+			std::string origin = Help::String::pathBasename(std::get<1>(it.first));
+			if (std::get<2>(it.first) > 0)
+				origin += ":" + std::to_string(std::get<2>(it.first));
+
+			rows.emplace_back(std::string(mKindNames[std::get<0>(it.first)]) + "\t" + origin, it.second);
+		}
+
+		// most main loop time first
+		std::sort(rows.begin(), rows.end(), [](const std::pair<std::string, Entry>& a, const std::pair<std::string, Entry>& b) {
+			return a.second.total > b.second.total;
+		});
+
+		gint64 uptime = g_get_monotonic_time() - mStartTime;
+		gchar* header = g_strdup_printf("# %" G_GINT64_FORMAT " s of accounting, %u main loop wakeups by timeouts and jobs, %u jobs queued, %u slices over budget\n"
+										"# kind\torigin\tcount\ttotal us\tmax us\tmean us\n",
+			uptime / G_USEC_PER_SEC, Help::Gtk::getWakeups(), Help::Gtk::getJobQueueDepth(), Help::Gtk::getJobOverruns());
+		std::string ret = header;
+		g_free(header);
+
+		for (const auto& row : rows)
+		{
+			gchar* line = g_strdup_printf("%s\t%u\t%" G_GINT64_FORMAT "\t%" G_GINT64_FORMAT "\t%" G_GINT64_FORMAT "\n",
+				row.first.c_str(), row.second.count, row.second.total, row.second.max, row.second.total / row.second.count);
+			ret += line;
+			g_free(line);
+		}
+
+		return ret;
+	}
+
+	void dump(std::string path)
+	{
+		if (path.empty())
+		{
+			gchar* basename = g_strdup_printf("stats-%d.tsv", xfce_panel_plugin_get_unique_id(Plugin::mXfPlugin));
+			gchar* filename = g_build_filename(g_get_user_cache_dir(), "xfce4-docklike-plugin", basename, nullptr);
+			path = filename;
+			g_free(filename);
+			g_free(basename);
+		}
+
+		std::string contents = report();
+		gchar* dir = g_path_get_dirname(path.c_str());
+		GError* error = nullptr;
+
+		g_mkdir_with_parents(dir, 0700);
+		g_free(dir);
+
+		if (g_file_set_contents(path.c_str(), contents.data(), contents.size(), &error))
+			g_message("Docklike stats written to '%s'", path.c_str());
+		else
+		{
+			g_warning("Failed to write stats file '%s': %s", path.c_str(), error->message);
+			g_error_free(error);
+		}
+	}
+
+	void finalize()
+	{
+		mEntries.clear();
+		mStartTime = g_get_monotonic_time();
+	}
+} // namespace Audit
@@ -0,0 +1,63 @@
+/*
+ * Copyright (c) 2019-2020 Nicolas Szabo <nszabo@vivaldi.net>
+ * Copyright (c) 2020-2021 David Keogh <davidtkeogh@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef AUDIT_HPP
+#define AUDIT_HPP
+
+#include <glib.h>
+
+#include <string>
+
+// Accounts for the time spent in the main loop callbacks the plugin owns: how often each
+// one ran, for how long in total and at most, keyed by where it was set up.
+// The report is written out by the "dump-stats" remote event.
+namespace Audit
+{
+	enum Kind
+	{
+		KIND_TIMEOUT,
+		KIND_IDLE,
+		KIND_SIGNAL,
+		KIND_DBUS
+	};
+
+	// `origin` must outlive the plugin: a string literal, usually __builtin_FILE()
+	void record(Kind kind, const char* origin, int line, gint64 duration);
+
+	// Records the time between its construction and its destruction
+	class Scope
+	{
+	public:
+		Scope(Kind kind, const char* origin, int line = 0);
+		~Scope();
+
+	private:
+		Kind mKind;
+		const char* mOrigin;
+		int mLine;
+		gint64 mStart;
+	};
+
+	std::string report();
+	// Writes the report to `path`, or to the user cache directory if it is empty
+	void dump(std::string path);
+
+	void finalize();
+} // namespace Audit
+
+#endif // AUDIT_HPP
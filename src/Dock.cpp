@@ -18,6 +18,11 @@
 
 #include "Dock.hpp"
 #include "LauncherEntry.hpp"
+#include "Trace.hpp"
+
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif
 
 namespace Dock
 {
@@ -27,6 +32,9 @@ namespace Dock
 	int mPanelSize;
 	int mIconSize;
 
+	// pinned apps still to add by queueDrawGroups()
+	std::list<std::string> mPinnedToAdd;
+
 	void init()
 	{
 		mBox = gtk_box_new(GTK_ORIENTATION_HORIZONTAL, 0);
@@ -84,47 +92,98 @@ namespace Dock
 		g_list_free(children);
 	}
 
+	static void addPinnedGroup(const std::string& id)
+	{
+		std::shared_ptr<AppInfo> appInfo = AppInfos::search(Help::String::toLowercase(id));
+		std::shared_ptr<Group> group = mGroups.get(appInfo);
+
+		// a window of the app opened while the groups were added in slices
+		if (group)
+		{
+			group->mPinned = true;
+			gtk_box_reorder_child(GTK_BOX(mBox), group->mButton, -1);
+			group->updateStyle();
+			return;
+		}
+
+		group = std::make_shared<Group>(appInfo, true);
+		mGroups.push(appInfo, group);
+		gtk_container_add(GTK_CONTAINER(mBox), group->mButton);
+	}
+
+	static void addWindow(XfwWindow* xfwWindow)
+	{
+		std::shared_ptr<GroupWindow> groupWindow = Xfw::mGroupWindows.get(xfwWindow);
+
+		if (!groupWindow)
+			groupWindow = std::make_shared<GroupWindow>(xfwWindow);
+		else
+			gtk_container_add(GTK_CONTAINER(mBox), groupWindow->mGroup->mButton);
+
+		Xfw::mGroupWindows.push(xfwWindow, groupWindow);
+		groupWindow->updateState();
+	}
+
 	void drawGroups()
 	{
+		TRACE_SPAN("Dock::drawGroups");
+		Help::Gtk::cancelJob(&mPinnedToAdd);
+
 		// Remove old groups
 		Xfw::mGroupWindows.clear();
 		mGroups.clear();
 
 		// Add pinned groups
 		std::list<std::string> pinnedApps = Settings::pinnedAppList;
-		std::list<std::string>::iterator it = pinnedApps.begin();
-
-		while (it != pinnedApps.end())
-		{
-			std::shared_ptr<AppInfo> appInfo = AppInfos::search(Help::String::toLowercase(*it));
-			std::shared_ptr<Group> group = std::make_shared<Group>(appInfo, true);
-
-			mGroups.push(appInfo, group);
-			gtk_container_add(GTK_CONTAINER(mBox), group->mButton);
-			++it;
-		}
+		for (const std::string& id : pinnedApps)
+			addPinnedGroup(id);
 
 		// Add open windows
 		for (GList* window_l = xfw_screen_get_windows(Xfw::mXfwScreen);
 			 window_l != nullptr;
 			 window_l = window_l->next)
-		{
-			XfwWindow* xfwWindow = XFW_WINDOW(window_l->data);
-			std::shared_ptr<GroupWindow> groupWindow = Xfw::mGroupWindows.get(xfwWindow);
-
-			if (!groupWindow)
-				groupWindow = std::make_shared<GroupWindow>(xfwWindow);
-			else
-				gtk_container_add(GTK_CONTAINER(mBox), groupWindow->mGroup->mButton);
-
-			Xfw::mGroupWindows.push(xfwWindow, groupWindow);
-			groupWindow->updateState();
-		}
+			addWindow(XFW_WINDOW(window_l->data));
 
 		gtk_widget_queue_draw(mBox);
 		LauncherEntry::refreshGroups();
 	}
 
+	void queueDrawGroups()
+	{
+		Xfw::mGroupWindows.clear();
+		mGroups.clear();
+		mPinnedToAdd = Settings::pinnedAppList;
+
+		Help::Gtk::queueJob(&mPinnedToAdd, Help::Gtk::JOB_NORMAL, []() {
+			TRACE_SPAN("Dock::queueDrawGroups");
+
+			if (!mPinnedToAdd.empty())
+			{
+				addPinnedGroup(mPinnedToAdd.front());
+				mPinnedToAdd.pop_front();
+				return true;
+			}
+
+			// windows opened since were added by Xfw already, and closed ones are gone
+			for (GList* window_l = xfw_screen_get_windows(Xfw::mXfwScreen);
+				 window_l != nullptr;
+				 window_l = window_l->next)
+			{
+				XfwWindow* xfwWindow = XFW_WINDOW(window_l->data);
+
+				if (!Xfw::mGroupWindows.get(xfwWindow))
+				{
+					addWindow(xfwWindow);
+					return true;
+				}
+			}
+
+			gtk_widget_queue_draw(mBox);
+			LauncherEntry::refreshGroups();
+			return false;
+		});
+	}
+
 	static void activateGroup(Group* group)
 	{
 		if (group->mActive)
@@ -160,6 +219,129 @@ namespace Dock
 		g_list_free(children);
 	}
 
+	static gint64 median(std::vector<gint64>& times)
+	{
+		std::sort(times.begin(), times.end());
+		return times[times.size() / 2];
+	}
+
+	void benchPopup()
+	{
+		Group* group = nullptr;
+		mGroups.forEach([&group](std::pair<std::shared_ptr<AppInfo>, std::shared_ptr<Group>> g) -> void {
+			if (group == nullptr || g.second->mWindowsCount > group->mWindowsCount)
+				group = g.second.get();
+		});
+
+		if (group == nullptr || group->mWindowsCount == 0)
+		{
+			g_warning("Popup bench: no group with windows");
+			return;
+		}
+
+		// Main loop time spent in popup() and in layoutItems(), not the time to the frame.
+		// Cold popups build their items first, warm ones reuse them.
+		const int runs = 20;
+		GroupMenu& menu = group->mGroupMenu;
+		std::vector<gint64> cold, warm, scroll;
+
+		for (int i = 0; i < runs; ++i)
+		{
+			menu.hide();
+			menu.releaseItems();
+
+			gint64 start = g_get_monotonic_time();
+			menu.popup();
+			cold.push_back(g_get_monotonic_time() - start);
+
+			menu.hide();
+			start = g_get_monotonic_time();
+			menu.popup();
+			warm.push_back(g_get_monotonic_time() - start);
+
+			bool horizontal = gtk_orientable_get_orientation(GTK_ORIENTABLE(menu.mBox)) == GTK_ORIENTATION_HORIZONTAL;
+			GtkAdjustment* adjustment = horizontal
+				? gtk_scrolled_window_get_hadjustment(GTK_SCROLLED_WINDOW(menu.mScrolledWindow))
+				: gtk_scrolled_window_get_vadjustment(GTK_SCROLLED_WINDOW(menu.mScrolledWindow));
+
+			start = g_get_monotonic_time();
+			gtk_adjustment_set_value(adjustment, (i % 2 == 0) ? gtk_adjustment_get_upper(adjustment) : 0);
+			menu.layoutItems();
+			scroll.push_back(g_get_monotonic_time() - start);
+		}
+
+		g_debug("Popup bench: %u windows, %u items in view, median of %d runs: cold popup %" G_GINT64_FORMAT
+				" us, warm popup %" G_GINT64_FORMAT " us, scroll across %" G_GINT64_FORMAT " us",
+			(uint)group->mWindowsCount, menu.mLastItem - menu.mFirstItem, runs, median(cold), median(warm), median(scroll));
+
+		menu.hide();
+	}
+
+	// heap in use, to compare what the buttons take
+	static gsize heapUsed()
+	{
+#if defined(__GLIBC__) && __GLIBC_PREREQ(2, 33)
+		return mallinfo2().uordblks;
+#else
+		return 0;
+#endif
+	}
+
+	void benchButtons()
+	{
+		if (mGroups.size() == 0)
+		{
+			g_warning("Button bench: no group to take the app from");
+			return;
+		}
+
+		// all buttons show the first group's app, in a box of their own that is not shown
+		std::shared_ptr<AppInfo> appInfo = mGroups.first()->mAppInfo;
+		bool lightweight = Settings::lightweightButtons;
+
+		for (bool mode : {false, true})
+		{
+			// rebuilds the dock too, buttons pick their widgets when built
+			Settings::lightweightButtons.set(mode);
+
+			for (int count : {10, 50, 100, 200})
+			{
+				GtkWidget* window = gtk_offscreen_window_new();
+				GtkWidget* box = gtk_box_new(GTK_ORIENTATION_HORIZONTAL, 0);
+				gtk_container_add(GTK_CONTAINER(window), box);
+				std::vector<std::shared_ptr<Group>> groups;
+
+				gsize heap = heapUsed();
+				gint64 start = g_get_monotonic_time();
+
+				for (int i = 0; i < count; ++i)
+				{
+					groups.push_back(std::make_shared<Group>(appInfo, true));
+					gtk_container_add(GTK_CONTAINER(box), groups.back()->mButton);
+				}
+
+				gint64 built = g_get_monotonic_time();
+				gtk_widget_show(box);
+				gtk_widget_show(window);
+				gint64 shown = g_get_monotonic_time();
+
+				gtk_widget_queue_resize(box);
+				gtk_container_check_resize(GTK_CONTAINER(window));
+				gint64 relayout = g_get_monotonic_time();
+
+				g_debug("Button bench: %s, %d buttons, built in %" G_GINT64_FORMAT " us, first layout %" G_GINT64_FORMAT
+						" us, layout again %" G_GINT64_FORMAT " us, %" G_GSIZE_FORMAT " bytes of heap",
+					mode ? "lightweight" : "widgets", count, built - start, shown - built, relayout - shown,
+					heapUsed() - heap);
+
+				groups.clear();
+				gtk_widget_destroy(window);
+			}
+		}
+
+		Settings::lightweightButtons.set(lightweight);
+	}
+
 	void activateGroup(const std::string& appId)
 	{
 		std::shared_ptr<Group> group =
@@ -176,6 +358,7 @@ namespace Dock
 			mPanelSize = size;
 
 		gtk_box_set_spacing(GTK_BOX(mBox), mPanelSize / 10);
+		Theme::updateLauncherCountStyle(mPanelSize);
 
 		if (Settings::forceIconSize)
 			mIconSize = Settings::iconSize;
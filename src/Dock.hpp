@@ -31,6 +31,7 @@
 
 #include <iostream>
 #include <string>
+#include <vector>
 
 class Group;
 
@@ -43,6 +44,13 @@ namespace Dock
 	void moveButton(Group* moving, Group* dest);
 	void savePinned();
 	void drawGroups();
+	// Same, one group or window per job slice
+	void queueDrawGroups();
+
+	// Times the popup of the group with the most windows, for the "bench-popup" remote event
+	void benchPopup();
+	// Builds and lays out 10 to 200 buttons of each kind, for the "bench-buttons" remote event
+	void benchButtons();
 
 	void activateGroup(int nb);
 	void activateGroup(const std::string& appId);
@@ -17,7 +17,10 @@
  */
 
 #include "Group.hpp"
+#include "Audit.hpp"
 #include "Hotkeys.hpp"
+#include "IconCache.hpp"
+#include "PowerSaver.hpp"
 
 static GtkTargetEntry entries[1] = {{(gchar*)"application/docklike_group", 0, 0}};
 static GtkTargetList* targetList = gtk_target_list_new(entries, 1);
@@ -30,6 +33,97 @@ static std::string getDragId(const std::shared_ptr<AppInfo>& appInfo)
 	return "id:" + appInfo->mId;
 }
 
+static bool isIconPath(const std::string& icon)
+{
+	return icon[0] == '/' && g_file_test(icon.c_str(), G_FILE_TEST_IS_REGULAR);
+}
+
+// Labels painted by the button itself get these style contexts in place of the GtkLabel
+// children they replace, so the existing CSS classes keep applying
+static void setChildStylePath(GtkStyleContext* sc, GtkWidget* parent, const char* styleClass)
+{
+	GtkWidgetPath* path = gtk_widget_path_copy(gtk_widget_get_path(parent));
+	gtk_widget_path_append_type(path, GTK_TYPE_LABEL);
+	gtk_widget_path_iter_add_class(path, -1, styleClass);
+	gtk_style_context_set_path(sc, path);
+	gtk_widget_path_free(path);
+}
+
+static GtkStyleContext* createChildStyle(GtkWidget* parent, const char* styleClass)
+{
+	GtkStyleContext* sc = gtk_style_context_new();
+	gtk_style_context_set_parent(sc, gtk_widget_get_style_context(parent));
+	setChildStylePath(sc, parent, styleClass);
+	return sc;
+}
+
+// Request what the button would ask for around a GtkImage of the icon size
+static void setButtonSizeRequest(GtkWidget* button)
+{
+	GtkStyleContext* sc = gtk_widget_get_style_context(button);
+	GtkStateFlags state = gtk_style_context_get_state(sc);
+	GtkBorder border, padding;
+	gtk_style_context_get_border(sc, state, &border);
+	gtk_style_context_get_padding(sc, state, &padding);
+	gtk_widget_set_size_request(button,
+		Dock::mIconSize + border.left + border.right + padding.left + padding.right,
+		Dock::mIconSize + border.top + border.bottom + padding.top + padding.bottom);
+}
+
+// The area inside the button's border and padding, where its child would be allocated
+static GdkRectangle getContentBox(GtkWidget* button)
+{
+	GtkStyleContext* sc = gtk_widget_get_style_context(button);
+	GtkStateFlags state = gtk_widget_get_state_flags(button);
+	GtkBorder border, padding;
+	gtk_style_context_get_border(sc, state, &border);
+	gtk_style_context_get_padding(sc, state, &padding);
+
+	GdkRectangle box;
+	box.x = border.left + padding.left;
+	box.y = border.top + padding.top;
+	box.width = gtk_widget_get_allocated_width(button) - box.x - border.right - padding.right;
+	box.height = gtk_widget_get_allocated_height(button) - box.y - border.bottom - padding.bottom;
+	return box;
+}
+
+// Places a label in a corner of the content box, the way a start or end aligned overlay would
+static GdkRectangle measureChildLabel(GtkStyleContext* sc, GtkStateFlags state, PangoLayout* layout, const GdkRectangle& box, bool alignEnd)
+{
+	GtkBorder margin, border, padding;
+	PangoFontDescription* font;
+	int minWidth, minHeight, textWidth, textHeight;
+
+	gtk_style_context_set_state(sc, state);
+	gtk_style_context_get(sc, state, "font", &font, "min-width", &minWidth, "min-height", &minHeight, nullptr);
+	gtk_style_context_get_margin(sc, state, &margin);
+	gtk_style_context_get_border(sc, state, &border);
+	gtk_style_context_get_padding(sc, state, &padding);
+
+	pango_layout_set_font_description(layout, font);
+	pango_font_description_free(font);
+	pango_layout_get_pixel_size(layout, &textWidth, &textHeight);
+
+	GdkRectangle rect;
+	rect.width = std::max(minWidth, textWidth) + padding.left + padding.right + border.left + border.right;
+	rect.height = std::max(minHeight, textHeight) + padding.top + padding.bottom + border.top + border.bottom;
+	rect.x = alignEnd ? box.x + box.width - margin.right - rect.width : box.x + margin.left;
+	rect.y = box.y + margin.top;
+	return rect;
+}
+
+static GdkRectangle drawChildLabel(cairo_t* cr, GtkStyleContext* sc, GtkStateFlags state, PangoLayout* layout, const GdkRectangle& box, bool alignEnd)
+{
+	GdkRectangle rect = measureChildLabel(sc, state, layout, box, alignEnd);
+	int textWidth, textHeight;
+	pango_layout_get_pixel_size(layout, &textWidth, &textHeight);
+
+	gtk_render_background(sc, cr, rect.x, rect.y, rect.width, rect.height);
+	gtk_render_frame(sc, cr, rect.x, rect.y, rect.width, rect.height);
+	gtk_render_layout(sc, cr, rect.x + (rect.width - textWidth) / 2., rect.y + (rect.height - textHeight) / 2., layout);
+	return rect;
+}
+
 static std::shared_ptr<Group> getDragGroup(const std::string& dragId)
 {
 	return Dock::mGroups.findIf(
@@ -38,7 +132,7 @@ static std::shared_ptr<Group> getDragGroup(const std::string& dragId)
 		});
 }
 
-Group::Group(std::shared_ptr<AppInfo> appInfo, bool pinned) : mPinned(pinned), mActive(false), mWindowMenuShown(false), mTopWindowIndex(0), mAppInfo(appInfo), mGroupMenu(this), mIconPixbuf(nullptr), mContextMenu(nullptr)
+Group::Group(std::shared_ptr<AppInfo> appInfo, bool pinned) : mPinned(pinned), mActive(false), mWindowMenuShown(false), mTopWindowIndex(0), mAppInfo(appInfo), mGroupMenu(this), mIconPixbuf(nullptr), mIconSurface(nullptr), mLabelStyle(nullptr), mLabelLayout(nullptr), mLauncherStyle(nullptr), mLauncherLayout(nullptr), mLauncherCount(-1), mLauncherCountVisible(false), mLauncherRedrawPending(false), mLauncherRect(), mContextMenu(nullptr)
 {
 	mWindowsCount.setup(
 		0,
@@ -53,17 +147,28 @@ Group::Group(std::shared_ptr<AppInfo> appInfo, bool pinned) : mPinned(pinned), m
 		}); return count; },
 		[this](uint windowsCount) -> void { updateStyle(); });
 
-	mLeaveTimeout.setup(40, [this]() {
-		uint distance = mGroupMenu.getPointerDistance();
+	mLeaveStart = mLeaveDeadline = mLeaveSample = 0;
+	mLeaveInterval = 0;
 
-		if (distance >= mTolerablePointerDistance)
+	mLeaveTimeout.setup(40, [this]() {
+		if (g_get_monotonic_time() >= mLeaveDeadline)
 		{
+			mLeaveDeadline = 0;
 			onMouseLeave();
 			return false;
 		}
 
-		mTolerablePointerDistance -= 10;
-		return true;
+		// Outside of the dock and popup no motion events arrive, so the pointer is sampled,
+		// soon after leaving to catch a fast exit, then less and less often.
+		gint x, y;
+		gdk_device_get_position(Plugin::mPointer, nullptr, &x, &y);
+		mLeaveInterval *= 2;
+		mLeaveSample = g_get_monotonic_time() + mLeaveInterval * 1000;
+		onPointerMotion(x, y);
+
+		if (mLeaveDeadline != 0)
+			armLeaveTimeout();
+		return false;
 	});
 
 	mMenuShowTimeout.setup(90, [this]() {
@@ -74,32 +179,39 @@ Group::Group(std::shared_ptr<AppInfo> appInfo, bool pinned) : mPinned(pinned), m
 	//--------------------------------------------------
 
 	mButton = GTK_WIDGET(g_object_ref(gtk_button_new()));
-	mImage = gtk_image_new();
-	mLabel = gtk_label_new("");
-	mLauncherLabel = gtk_label_new("");
-	mLauncherCountCssProvider = gtk_css_provider_new();
-	gtk_widget_set_no_show_all(mLauncherLabel, true);
-	GtkWidget* overlay = gtk_overlay_new();
-
-	// The button contains a GtkOverlay, so that the labels can be placed on top of the image.
-	gtk_label_set_use_markup(GTK_LABEL(mLabel), true);
-	gtk_container_add(GTK_CONTAINER(overlay), mImage);
-	gtk_overlay_add_overlay(GTK_OVERLAY(overlay), mLabel);
-	gtk_overlay_add_overlay(GTK_OVERLAY(overlay), mLauncherLabel);
-	gtk_widget_set_halign(mLabel, GTK_ALIGN_START);
-	gtk_widget_set_valign(mLabel, GTK_ALIGN_START);
-	gtk_widget_set_halign(mLauncherLabel, GTK_ALIGN_END);
-	gtk_widget_set_valign(mLauncherLabel, GTK_ALIGN_START);
-	gtk_overlay_set_overlay_pass_through(GTK_OVERLAY(overlay), mLabel, true);
-	gtk_overlay_set_overlay_pass_through(GTK_OVERLAY(overlay), mLauncherLabel, true);
-	gtk_container_add(GTK_CONTAINER(mButton), overlay);
-
 	Help::Gtk::cssClassAdd(mButton, "flat");
 	Help::Gtk::cssClassAdd(mButton, "group");
-	Help::Gtk::cssClassAdd(mLabel, "window_count");
-	Help::Gtk::cssClassAdd(mLauncherLabel, "launcher_count");
-	gtk_style_context_add_provider(gtk_widget_get_style_context(mLauncherLabel),
-		GTK_STYLE_PROVIDER(mLauncherCountCssProvider), GTK_STYLE_PROVIDER_PRIORITY_APPLICATION);
+
+	// The launcher badge is always painted by onDraw(): count updates then only repaint its area.
+	mLauncherStyle = createChildStyle(mButton, "launcher_count");
+	gtk_style_context_add_provider(mLauncherStyle,
+		GTK_STYLE_PROVIDER(Theme::getLauncherCountProvider()), GTK_STYLE_PROVIDER_PRIORITY_APPLICATION);
+	mLauncherLayout = gtk_widget_create_pango_layout(mButton, nullptr);
+
+	if (Settings::lightweightButtons)
+	{
+		// The button has no children: the icon and the window count are painted by onDraw() too.
+		mImage = mLabel = nullptr;
+		mLabelStyle = createChildStyle(mButton, "window_count");
+		mLabelLayout = gtk_widget_create_pango_layout(mButton, nullptr);
+	}
+	else
+	{
+		mImage = gtk_image_new();
+		mLabel = gtk_label_new("");
+		GtkWidget* overlay = gtk_overlay_new();
+
+		// The button contains a GtkOverlay, so that the label can be placed on top of the image.
+		gtk_label_set_use_markup(GTK_LABEL(mLabel), true);
+		gtk_container_add(GTK_CONTAINER(overlay), mImage);
+		gtk_overlay_add_overlay(GTK_OVERLAY(overlay), mLabel);
+		gtk_widget_set_halign(mLabel, GTK_ALIGN_START);
+		gtk_widget_set_valign(mLabel, GTK_ALIGN_START);
+		gtk_overlay_set_overlay_pass_through(GTK_OVERLAY(overlay), mLabel, true);
+		gtk_container_add(GTK_CONTAINER(mButton), overlay);
+
+		Help::Gtk::cssClassAdd(mLabel, "window_count");
+	}
 
 	g_object_set_data(G_OBJECT(mButton), "group", this);
 	gtk_button_set_relief(GTK_BUTTON(mButton), GTK_RELIEF_NONE);
@@ -174,13 +286,8 @@ Group::Group(std::shared_ptr<AppInfo> appInfo, bool pinned) : mPinned(pinned), m
 		G_CALLBACK(+[](GtkWidget* widget, GdkEventCrossing* event, Group* me) {
 			Help::Gtk::cssClassAdd(me->mButton, "hover_group");
 			me->mLeaveTimeout.stop();
+			me->mLeaveDeadline = 0;
 			me->mMenuShowTimeout.start();
-
-			if (Settings::showPreviews)
-				me->mWindows.forEach([](GroupWindow* w) -> void {
-					w->mGroupMenuItem->mPreviewTimeout.start();
-				});
-
 			return false;
 		}),
 		this);
@@ -193,12 +300,7 @@ Group::Group(std::shared_ptr<AppInfo> appInfo, bool pinned) : mPinned(pinned), m
 			if (me->mPinned && !me->mWindowsCount)
 				me->onMouseLeave();
 			else
-				me->setMouseLeaveTimeout();
-
-			if (Settings::showPreviews)
-				me->mWindows.forEach([](GroupWindow* w) -> void {
-					w->mGroupMenuItem->mPreviewTimeout.stop();
-				});
+				me->setMouseLeaveTimeout(event->x_root, event->y_root);
 
 			return false;
 		}),
@@ -206,6 +308,7 @@ Group::Group(std::shared_ptr<AppInfo> appInfo, bool pinned) : mPinned(pinned), m
 
 	g_signal_connect_after(G_OBJECT(mButton), "draw",
 		G_CALLBACK(+[](GtkWidget* widget, cairo_t* cr, Group* me) {
+			Audit::Scope audit(Audit::KIND_SIGNAL, "group button draw");
 			me->onDraw(cr);
 			return false;
 		}),
@@ -217,20 +320,31 @@ Group::Group(std::shared_ptr<AppInfo> appInfo, bool pinned) : mPinned(pinned), m
 		}),
 		this);
 
+	g_signal_connect(G_OBJECT(mButton), "style-updated",
+		G_CALLBACK(+[](GtkWidget* widget, Group* me) {
+			setChildStylePath(me->mLauncherStyle, widget, "launcher_count");
+
+			if (me->mImage == nullptr)
+			{
+				setChildStylePath(me->mLabelStyle, widget, "window_count");
+				setButtonSizeRequest(widget);
+			}
+		}),
+		this);
+
 	//--------------------------------------------------
 
 	if (mPinned)
 		gtk_widget_show_all(mButton);
 
 	if (mAppInfo != nullptr && !mAppInfo->mIcon.empty())
-	{
-		if (mAppInfo->mIcon[0] == '/' && g_file_test(mAppInfo->mIcon.c_str(), G_FILE_TEST_IS_REGULAR))
-			mIconPixbuf = gdk_pixbuf_new_from_file(mAppInfo->mIcon.c_str(), nullptr);
-		else
-			gtk_image_set_from_icon_name(GTK_IMAGE(mImage), mAppInfo->mIcon.c_str(), GTK_ICON_SIZE_BUTTON);
-	}
+		mIconName = mAppInfo->mIcon;
 	else
-		gtk_image_set_from_icon_name(GTK_IMAGE(mImage), "application-x-executable", GTK_ICON_SIZE_BUTTON);
+		mIconName = "application-x-executable";
+
+	// file icons are only decoded when the icon cache can't provide them, see loadIconPixbuf()
+	if (mImage != nullptr && !isIconPath(mIconName))
+		gtk_image_set_from_icon_name(GTK_IMAGE(mImage), mIconName.c_str(), GTK_ICON_SIZE_BUTTON);
 
 	resize();
 	updateStyle();
@@ -249,14 +363,20 @@ Group::~Group()
 	if (mIconPixbuf != nullptr)
 		g_object_unref(mIconPixbuf);
 
-	g_object_unref(mLauncherCountCssProvider);
+	if (mIconSurface != nullptr)
+		cairo_surface_destroy(mIconSurface);
+
+	g_clear_object(&mLabelStyle);
+	g_clear_object(&mLauncherStyle);
+	g_clear_object(&mLabelLayout);
+	g_clear_object(&mLauncherLayout);
 }
 
 void Group::add(GroupWindow* window)
 {
 	mWindows.push(window);
 	mWindowsCount.updateState();
-	mGroupMenu.add(window->mGroupMenuItem);
+	mGroupMenu.add(window);
 	Help::Gtk::cssClassAdd(mButton, "open_group");
 
 	if (mWindowsCount == 1 && !mPinned)
@@ -272,7 +392,7 @@ void Group::remove(GroupWindow* window)
 {
 	mWindows.pop(window);
 	mWindowsCount.updateState();
-	mGroupMenu.remove(window->mGroupMenuItem);
+	mGroupMenu.remove(window);
 
 	if (mTopWindowIndex >= mWindowsCount)
 		mTopWindowIndex = 0;
@@ -328,22 +448,6 @@ void Group::closeAll()
 
 void Group::resize()
 {
-	// The badge's current proportions look right on a 56 px panel. Scale all of its
-	// dimensions from that baseline, but limit growth to 125% so it does not dominate
-	// large panels and keep a 60% floor so the count remains legible on very small ones.
-	const double launcherCountScale = CLAMP(Dock::mPanelSize / 56.0, 0.6, 1.25);
-	const int launcherCountFontSize = round(100 * launcherCountScale);
-	const int launcherCountMinWidth = round(12 * launcherCountScale);
-	const int launcherCountVerticalPadding = std::max(1, (int)round(launcherCountScale));
-	const int launcherCountHorizontalPadding = round(4 * launcherCountScale);
-	const int launcherCountMargin = std::max(1, (int)round(launcherCountScale));
-	gchar* launcherCountCss = g_strdup_printf(
-		".launcher_count { min-width: %dpx; font-size: %d%%; padding: %dpx %dpx; margin: %dpx; }",
-		launcherCountMinWidth, launcherCountFontSize, launcherCountVerticalPadding,
-		launcherCountHorizontalPadding, launcherCountMargin);
-	gtk_css_provider_load_from_data(mLauncherCountCssProvider, launcherCountCss, -1, nullptr);
-	g_free(launcherCountCss);
-
 	// TODO: set `min-width` / `min-height` CSS property on button?
 	// https://github.com/davekeogh/xfce4-docklike-plugin/issues/39
 
@@ -351,30 +455,97 @@ void Group::resize()
 	if (Dock::mIconSize == 0)
 		return;
 
-	if (mIconPixbuf != nullptr)
+	gint scale_factor = gtk_widget_get_scale_factor(mButton);
+	cairo_surface_t* surface = nullptr;
+
+	if (!Settings::disableIconCache)
+		surface = IconCache::lookup(mIconName, Dock::mIconSize, scale_factor);
+
+	if (surface == nullptr && loadIconPixbuf())
 	{
-		gint scale_factor = gtk_widget_get_scale_factor(mButton);
 		gint size = Dock::mIconSize * scale_factor;
 		GdkPixbuf* scaled = gdk_pixbuf_scale_simple(mIconPixbuf, size, size, GDK_INTERP_BILINEAR);
-		cairo_surface_t* surface = gdk_cairo_surface_create_from_pixbuf(scaled, scale_factor, nullptr);
-		gtk_image_set_from_surface(GTK_IMAGE(mImage), surface);
-		cairo_surface_destroy(surface);
+		surface = gdk_cairo_surface_create_from_pixbuf(scaled, scale_factor, nullptr);
 		g_object_unref(scaled);
 	}
+
+	if (mImage != nullptr)
+	{
+		if (surface != nullptr)
+		{
+			gtk_image_set_from_surface(GTK_IMAGE(mImage), surface);
+			cairo_surface_destroy(surface);
+		}
+		else
+		{
+			gtk_image_set_from_icon_name(GTK_IMAGE(mImage), mIconName.c_str(), GTK_ICON_SIZE_BUTTON);
+			gtk_image_set_pixel_size(GTK_IMAGE(mImage), Dock::mIconSize);
+		}
+
+		gtk_widget_set_valign(mImage, GTK_ALIGN_CENTER);
+	}
 	else
-		gtk_image_set_pixel_size(GTK_IMAGE(mImage), Dock::mIconSize);
+	{
+		if (surface == nullptr)
+			surface = gtk_icon_theme_load_surface(gtk_icon_theme_get_default(), mIconName.c_str(),
+				Dock::mIconSize, scale_factor, nullptr, GTK_ICON_LOOKUP_FORCE_SIZE, nullptr);
+		if (surface == nullptr)
+			surface = gtk_icon_theme_load_surface(gtk_icon_theme_get_default(), "application-x-executable",
+				Dock::mIconSize, scale_factor, nullptr, GTK_ICON_LOOKUP_FORCE_SIZE, nullptr);
+
+		if (mIconSurface != nullptr)
+			cairo_surface_destroy(mIconSurface);
+		mIconSurface = surface;
+
+		setButtonSizeRequest(mButton);
+	}
 
-	gtk_widget_set_valign(mImage, GTK_ALIGN_CENTER);
 	gtk_widget_queue_draw(mButton);
 
 	updateIconGeometry();
 }
 
+bool Group::loadIconPixbuf()
+{
+	if (mIconPixbuf == nullptr && isIconPath(mIconName))
+		mIconPixbuf = gdk_pixbuf_new_from_file(mIconName.c_str(), nullptr);
+
+	return mIconPixbuf != nullptr;
+}
+
+void Group::drawContents(cairo_t* cr)
+{
+	GtkStateFlags state = gtk_widget_get_state_flags(mButton);
+	GdkRectangle box = getContentBox(mButton);
+
+	if (mImage == nullptr && mIconSurface != nullptr)
+	{
+		double scaleX, scaleY;
+		cairo_surface_get_device_scale(mIconSurface, &scaleX, &scaleY);
+		double iconWidth = cairo_image_surface_get_width(mIconSurface) / scaleX;
+		double iconHeight = cairo_image_surface_get_height(mIconSurface) / scaleY;
+
+		cairo_save(cr);
+		cairo_set_source_surface(cr, mIconSurface,
+			box.x + round((box.width - iconWidth) / 2), box.y + round((box.height - iconHeight) / 2));
+		cairo_paint(cr);
+		cairo_restore(cr);
+	}
+
+	if (mImage == nullptr && *pango_layout_get_text(mLabelLayout) != '\0')
+		drawChildLabel(cr, mLabelStyle, state, mLabelLayout, box, false);
+
+	if (mLauncherCountVisible)
+		mLauncherRect = drawChildLabel(cr, mLauncherStyle, state, mLauncherLayout, box, true);
+}
+
 void Group::onDraw(cairo_t* cr)
 {
 	int w = gtk_widget_get_allocated_width(mButton);
 	int h = gtk_widget_get_allocated_height(mButton);
 
+	drawContents(cr);
+
 	double rgba[4];
 
 	if (Settings::indicatorColorFromTheme)
@@ -824,10 +995,59 @@ void Group::onMouseLeave()
 
 void Group::setMouseLeaveTimeout()
 {
-	mTolerablePointerDistance = 200;
+	gint x, y;
+
+	// without a crossing event to read it from, the pointer position is asked for once
+	gdk_device_get_position(Plugin::mPointer, nullptr, &x, &y);
+	setMouseLeaveTimeout(x, y);
+}
+
+void Group::setMouseLeaveTimeout(int x, int y)
+{
+	mLeaveTimeout.stop();
+	mLeaveStart = g_get_monotonic_time();
+	mLeaveDeadline = G_MAXINT64;
+	mLeaveInterval = 40;
+	mLeaveSample = mLeaveStart + mLeaveInterval * 1000;
+	onPointerMotion(x, y);
+
+	if (mLeaveDeadline != 0)
+		armLeaveTimeout();
+}
+
+void Group::armLeaveTimeout()
+{
+	gint64 next = std::min(mLeaveDeadline, mLeaveSample);
+	mLeaveTimeout.mDuration = std::max<gint64>(next - g_get_monotonic_time() + 999, 0) / 1000;
 	mLeaveTimeout.start();
 }
 
+void Group::onPointerMotion(int x, int y)
+{
+	if (mLeaveDeadline == 0)
+		return;
+
+	// The popup stays for up to 840 ms while the pointer is near it, less the farther it
+	// is, and the deadline only ever moves closer as the pointer is seen moving.
+	uint distance = mGroupMenu.getPointerDistance(x, y);
+	gint64 steps = distance >= 200 ? 1 : (219 - distance) / 10;
+	gint64 deadline = mLeaveStart + steps * 40000;
+
+	if (deadline >= mLeaveDeadline)
+		return;
+
+	mLeaveDeadline = deadline;
+
+	if (deadline <= g_get_monotonic_time())
+	{
+		mLeaveTimeout.stop();
+		mLeaveDeadline = 0;
+		onMouseLeave();
+	}
+	else if (mLeaveTimeout.mTimeoutId != 0 && deadline < mLeaveSample)
+		armLeaveTimeout();
+}
+
 void Group::updateStyle()
 {
 	if (mPinned || mWindowsCount > 0)
@@ -845,26 +1065,53 @@ void Group::updateStyle()
 	else
 		gtk_widget_set_tooltip_text(mButton, mAppInfo->mName.c_str());
 
-	if (mWindowsCount > 2 && Settings::showWindowCount)
-	{
-		gchar* markup = g_strdup_printf("<b>%d</b>", (int)mWindowsCount);
+	gchar* markup = (mWindowsCount > 2 && Settings::showWindowCount)
+		? g_strdup_printf("<b>%d</b>", (int)mWindowsCount)
+		: g_strdup("");
+
+	if (mLabel != nullptr)
 		gtk_label_set_markup(GTK_LABEL(mLabel), markup);
-		g_free(markup);
-	}
 	else
-		gtk_label_set_markup(GTK_LABEL(mLabel), "");
+	{
+		pango_layout_set_markup(mLabelLayout, markup, -1);
+		gtk_widget_queue_draw(mButton);
+	}
+
+	g_free(markup);
 }
 
 void Group::setLauncherCount(gint64 count, bool visible)
 {
-	if (!visible)
+	if (visible == mLauncherCountVisible && (!visible || count == mLauncherCount))
+		return;
+
+	bool draw = !PowerSaver::isSuspended();
+
+	// the badge area as last painted, so that a shrinking or hidden badge gets cleared
+	if (draw && mLauncherCountVisible && mLauncherRect.width > 0)
+		gtk_widget_queue_draw_area(mButton, mLauncherRect.x, mLauncherRect.y, mLauncherRect.width, mLauncherRect.height);
+
+	if (count != mLauncherCount)
 	{
-		gtk_widget_hide(mLauncherLabel);
+		pango_layout_set_text(mLauncherLayout, std::to_string(count).c_str(), -1);
+		mLauncherCount = count;
+	}
+
+	mLauncherCountVisible = visible;
+
+	// the whole button is redrawn on resume
+	if (!draw)
+	{
+		mLauncherRedrawPending = true;
 		return;
 	}
 
-	gtk_label_set_text(GTK_LABEL(mLauncherLabel), std::to_string(count).c_str());
-	gtk_widget_show(mLauncherLabel);
+	if (visible && gtk_widget_get_realized(mButton))
+	{
+		GdkRectangle rect = measureChildLabel(mLauncherStyle, gtk_widget_get_state_flags(mButton),
+			mLauncherLayout, getContentBox(mButton), true);
+		gtk_widget_queue_draw_area(mButton, rect.x, rect.y, rect.width, rect.height);
+	}
 }
 
 void Group::updateIconGeometry()
@@ -1191,7 +1438,7 @@ void Group::onDragDataReceived(const GdkDragContext* context, int x, int y, cons
 
 void Group::onDragBegin(GdkDragContext* context)
 {
-	if (mIconPixbuf != nullptr)
+	if (loadIconPixbuf())
 	{
 		gint scale_factor = gtk_widget_get_scale_factor(mButton);
 		gint size;
@@ -1205,9 +1452,5 @@ void Group::onDragBegin(GdkDragContext* context)
 		g_object_unref(scaled);
 	}
 	else
-	{
-		const gchar* icon_name;
-		gtk_image_get_icon_name(GTK_IMAGE(mImage), &icon_name, nullptr);
-		gtk_drag_set_icon_name(context, icon_name, 0, 0);
-	}
+		gtk_drag_set_icon_name(context, mIconName.c_str(), 0, 0);
 }
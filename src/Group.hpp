@@ -79,6 +79,8 @@ public:
 	void updateIconGeometry();
 	void setLauncherCount(gint64 count, bool visible);
 
+	bool loadIconPixbuf();
+	void drawContents(cairo_t* cr);
 	void onDraw(cairo_t* cr);
 	void onWindowActivate(GroupWindow* groupWindow);
 	void onWindowUnactivate();
@@ -88,6 +90,9 @@ public:
 	void onMouseEnter();
 	void onMouseLeave();
 	void setMouseLeaveTimeout();
+	void setMouseLeaveTimeout(int x, int y);
+	void onPointerMotion(int x, int y);
+	void armLeaveTimeout();
 	bool onDragMotion(GtkWidget* widget, GdkDragContext* context, int x, int y, guint time);
 	void onDragLeave(const GdkDragContext* context, guint time);
 	void onDragDataGet(const GdkDragContext* context, GtkSelectionData* selectionData, guint info, guint time);
@@ -98,7 +103,12 @@ public:
 	bool mActive;
 	bool mWindowMenuShown;
 
-	uint mTolerablePointerDistance;
+	// pointer left the button or popup at mLeaveStart, the popup hides at mLeaveDeadline,
+	// and the pointer is sampled at mLeaveSample, mLeaveInterval ms after the last sample
+	gint64 mLeaveStart;
+	gint64 mLeaveDeadline;
+	gint64 mLeaveSample;
+	uint mLeaveInterval;
 	uint mTopWindowIndex;
 	Store::List<GroupWindow*> mWindows;
 	LogicalState<uint> mWindowsCount;
@@ -108,10 +118,23 @@ public:
 
 	GtkWidget* mButton;
 	GtkWidget* mLabel;
-	GtkWidget* mLauncherLabel;
-	GtkCssProvider* mLauncherCountCssProvider;
 	GtkWidget* mImage;
+	std::string mIconName;
 	GdkPixbuf* mIconPixbuf;
+
+	// lightweight buttons only, in place of mImage and mLabel
+	cairo_surface_t* mIconSurface;
+	GtkStyleContext* mLabelStyle;
+	PangoLayout* mLabelLayout;
+
+	// the launcher badge is painted on top of the button contents
+	GtkStyleContext* mLauncherStyle;
+	PangoLayout* mLauncherLayout;
+	gint64 mLauncherCount;
+	bool mLauncherCountVisible;
+	bool mLauncherRedrawPending; // changed while the power saver held back drawing
+	GdkRectangle mLauncherRect;
+
 	GtkWidget* mContextMenu;
 
 	Help::Gtk::Timeout mLeaveTimeout;
@@ -24,97 +24,85 @@
 #include "GroupMenu.hpp"
 #include "GroupMenuItem.hpp"
 #include "Plugin.hpp"
-
-static GtkWidget*
-create_window()
-{
-	GtkWidget* window = gtk_window_new(GTK_WINDOW_POPUP);
-	gtk_widget_add_events(window, GDK_SCROLL_MASK);
-	gtk_window_set_default_size(GTK_WINDOW(window), 1, 1);
-
-	gtk_widget_set_app_paintable(window, true);
-	GdkScreen* screen = gtk_widget_get_screen(window);
-	GdkVisual* visual = gdk_screen_get_rgba_visual(screen);
-	if (visual != nullptr)
-	{
-		gtk_widget_set_visual(window, visual);
-	}
-
-#ifdef ENABLE_WAYLAND
-	if (gtk_layer_is_supported())
-	{
-		gtk_layer_init_for_window(GTK_WINDOW(window));
-		gtk_layer_set_exclusive_zone(GTK_WINDOW(window), -1);
-		gtk_layer_set_anchor(GTK_WINDOW(window), GTK_LAYER_SHELL_EDGE_TOP, true);
-		gtk_layer_set_anchor(GTK_WINDOW(window), GTK_LAYER_SHELL_EDGE_LEFT, true);
-	}
-#endif
-
-	return window;
-}
+#include "PopupWindow.hpp"
+#include "PreviewPrefetch.hpp"
+#include "PreviewScheduler.hpp"
 
 GroupMenu::GroupMenu(Group* dockButton)
 {
 	mGroup = dockButton;
 	mVisible = false;
 	mMouseHover = false;
-	mWindow = create_window();
+	mRect = {0, 0, 0, 0};
+	mScrolledWindow = gtk_scrolled_window_new(nullptr, nullptr);
 	mBox = gtk_box_new(GTK_ORIENTATION_VERTICAL, 0);
+	mSpacerBefore = gtk_drawing_area_new();
+	mSpacerAfter = gtk_drawing_area_new();
+
+	mItemExtent = 0;
+	mMaxExtent = 0;
+	mFirstItem = mLastItem = mItemCount = 0;
 
-	Help::Gtk::cssClassAdd(mWindow, "xfce-docklike-window");
 	Help::Gtk::cssClassAdd(mBox, "menu");
 
-	gtk_container_add(GTK_CONTAINER(mWindow), mBox);
+	// The popup grows with its contents up to the size of the monitor, then scrolls
+	gtk_scrolled_window_set_propagate_natural_width(GTK_SCROLLED_WINDOW(mScrolledWindow), true);
+	gtk_scrolled_window_set_propagate_natural_height(GTK_SCROLLED_WINDOW(mScrolledWindow), true);
+	gtk_scrolled_window_set_shadow_type(GTK_SCROLLED_WINDOW(mScrolledWindow), GTK_SHADOW_NONE);
+	g_object_ref_sink(mScrolledWindow); // moves in and out of the popup window
+
+	gtk_box_pack_start(GTK_BOX(mBox), mSpacerBefore, false, false, 0);
+	gtk_box_pack_start(GTK_BOX(mBox), mSpacerAfter, false, false, 0);
+	gtk_widget_show(mSpacerBefore);
+	gtk_widget_show(mSpacerAfter);
+
+	gtk_container_add(GTK_CONTAINER(mScrolledWindow), mBox);
 	gtk_widget_show(mBox);
+	gtk_widget_show(mScrolledWindow);
 
 	mPopupIdle.setup([this]() {
 		popup();
 		return false;
-	});
+	},
+		Help::Gtk::JOB_HIGH);
 
-	//--------------------------------------------------
+	// adjustments change during size allocation, the items are laid out right after it
+	mLayoutIdle.setup([this]() {
+		layoutItems();
+		return false;
+	},
+		Help::Gtk::JOB_HIGH);
 
-	g_signal_connect(G_OBJECT(mWindow), "enter-notify-event",
-		G_CALLBACK(+[](GtkWidget* widget, GdkEvent* event, GroupMenu* me) {
-			me->mMouseHover = true;
+	for (GtkAdjustment* adjustment : {gtk_scrolled_window_get_hadjustment(GTK_SCROLLED_WINDOW(mScrolledWindow)),
+			 gtk_scrolled_window_get_vadjustment(GTK_SCROLLED_WINDOW(mScrolledWindow))})
+	{
+		g_signal_connect(G_OBJECT(adjustment), "value-changed",
+			G_CALLBACK(+[](GtkAdjustment* _adjustment, GroupMenu* me) {
+				if (me->mVisible)
+					me->mLayoutIdle.start();
+			}),
+			this);
+
+		g_signal_connect(G_OBJECT(adjustment), "changed",
+			G_CALLBACK(+[](GtkAdjustment* _adjustment, GroupMenu* me) {
+				if (me->mVisible)
+					me->mLayoutIdle.start();
+			}),
+			this);
+	}
 
-			if (Settings::showPreviews)
-				me->mGroup->mWindows.forEach([](GroupWindow* w) -> void {
-					w->mGroupMenuItem->updatePreview();
-				});
+	mPopupTime = 0;
 
-			return true;
-		}),
-		this);
+	//--------------------------------------------------
 
-	g_signal_connect(G_OBJECT(mWindow), "leave-notify-event",
-		G_CALLBACK(+[](GtkWidget* widget, GdkEventCrossing* event, GroupMenu* me) {
-			if (event->detail == GDK_NOTIFY_INFERIOR)
+	g_signal_connect(G_OBJECT(mBox), "draw",
+		G_CALLBACK(+[](GtkWidget* widget, cairo_t* cr, GroupMenu* me) {
+			if (me->mPopupTime != 0)
 			{
-				return false;
+				g_debug("Popup: first frame %" G_GINT64_FORMAT " us after hover", g_get_monotonic_time() - me->mPopupTime);
+				me->mPopupTime = 0;
 			}
-			me->mGroup->setMouseLeaveTimeout();
-			me->mMouseHover = false;
-
-			return true;
-		}),
-		this);
-
-	g_signal_connect(G_OBJECT(mWindow), "scroll-event",
-		G_CALLBACK(+[](GtkWidget* widget, GdkEventScroll* event, GroupMenu* me) {
-			((Group*)me->mGroup)->scrollWindows(event->time, event->direction);
-			return true;
-		}),
-		this);
-
-	g_signal_connect(G_OBJECT(Plugin::mXfPlugin), "notify::scale-factor",
-		G_CALLBACK(+[](GtkWidget* widget, GParamSpec* pspec, GroupMenu* me) {
-			g_object_ref(me->mBox);
-			gtk_container_remove(GTK_CONTAINER(me->mWindow), me->mBox);
-			gtk_widget_destroy(me->mWindow);
-			me->mWindow = create_window();
-			gtk_container_add(GTK_CONTAINER(me->mWindow), me->mBox);
-			g_object_unref(me->mBox);
+			return false;
 		}),
 		this);
 }
@@ -122,24 +110,35 @@ GroupMenu::GroupMenu(Group* dockButton)
 GroupMenu::~GroupMenu()
 {
 	mPopupIdle.stop();
-	gtk_widget_destroy(mWindow);
+	mLayoutIdle.stop();
+	mReleaseTimeout.stop();
+
+	for (GtkAdjustment* adjustment : {gtk_scrolled_window_get_hadjustment(GTK_SCROLLED_WINDOW(mScrolledWindow)),
+			 gtk_scrolled_window_get_vadjustment(GTK_SCROLLED_WINDOW(mScrolledWindow))})
+		g_signal_handlers_disconnect_by_data(G_OBJECT(adjustment), this);
+
+	PopupWindow::forget(this);
+	g_object_unref(mScrolledWindow);
 }
 
-void GroupMenu::add(GroupMenuItem* menuItem)
+void GroupMenu::add(GroupWindow* window)
 {
-	gtk_box_pack_end(GTK_BOX(mBox), GTK_WIDGET(menuItem->mItem), false, true, 0);
-
 	if (mVisible)
 		mPopupIdle.start();
 }
 
-void GroupMenu::remove(GroupMenuItem* menuItem)
+void GroupMenu::remove(GroupWindow* window)
 {
-	gtk_container_remove(GTK_CONTAINER(mBox), GTK_WIDGET(menuItem->mItem));
-	gtk_window_resize(GTK_WINDOW(mWindow), 1, 1);
+	// the window may come back, its item is built again then
+	window->releaseMenuItem();
+
+	if (PopupWindow::isOwner(this))
+	{
+		gtk_window_resize(PopupWindow::get(), 1, 1);
 
-	if (mGroup->mWindowsCount < (Settings::noWindowsListIfSingle ? 2 : 1))
-		gtk_widget_hide(mWindow);
+		if (mGroup->mWindowsCount < (Settings::noWindowsListIfSingle ? 2 : 1))
+			PopupWindow::hide(this);
+	}
 
 	if (mVisible)
 		mPopupIdle.start();
@@ -150,33 +149,253 @@ void GroupMenu::popup()
 	if (mGroup->mWindowsCount >= (Settings::noWindowsListIfSingle ? 2 : 1))
 	{
 		gint wx, wy;
+		gint64 start = g_get_monotonic_time();
+
+		mReleaseTimeout.stop();
+		PopupWindow::attach(this);
+		GtkWindow* window = PopupWindow::get();
+
+		if (!mVisible)
+		{
+			mPopupTime = start;
+			if (Settings::showPreviews)
+				PreviewPrefetch::popupShown(mGroup);
+		}
 		mVisible = true;
 
 		updateOrientation();
+		layoutItems();
+
+		mGroup->mWindows.forEach([](GroupWindow* w) -> void {
+			if (w->mGroupMenuItem != nullptr)
+				w->mGroupMenuItem->flushUpdates();
+		});
+
+		// Previews have a fixed size, so the window is sized right away and shows cached
+		// frames until the new captures come in.
+		if (Settings::showPreviews)
+			gtk_window_resize(window, 1, 1);
+
+		xfce_panel_plugin_position_widget(Plugin::mXfPlugin, GTK_WIDGET(window), mGroup->mButton, &wx, &wy);
+		updatePosition(wx, wy);
+		gtk_widget_show(GTK_WIDGET(window));
 
-		// Update the previews before showing the window
 		if (Settings::showPreviews)
+			schedulePreviews();
+
+		g_debug("Popup: shown in %" G_GINT64_FORMAT " us", g_get_monotonic_time() - start);
+	}
+}
+
+// Natural size of the item along the list, without the row size it may have been given
+static int measureItem(GroupMenuItem* menuItem, bool horizontal)
+{
+	GtkWidget* item = GTK_WIDGET(menuItem->mItem);
+	int minimum, natural;
+
+	// long titles would make tiles of different widths
+	gtk_label_set_max_width_chars(menuItem->mLabel, horizontal ? gtk_label_get_width_chars(menuItem->mLabel) : -1);
+	gtk_widget_set_size_request(item, -1, -1);
+
+	if (horizontal)
+		gtk_widget_get_preferred_width(item, &minimum, &natural);
+	else
+		gtk_widget_get_preferred_height(item, &minimum, &natural);
+
+	return MAX(natural, 1);
+}
+
+void GroupMenu::layoutItems()
+{
+	bool horizontal = gtk_orientable_get_orientation(GTK_ORIENTABLE(mBox)) == GTK_ORIENTATION_HORIZONTAL;
+	GtkAdjustment* adjustment = horizontal
+		? gtk_scrolled_window_get_hadjustment(GTK_SCROLLED_WINDOW(mScrolledWindow))
+		: gtk_scrolled_window_get_vadjustment(GTK_SCROLLED_WINDOW(mScrolledWindow));
+	uint count = mGroup->mWindows.size();
+
+	// Rows all get the size of the largest item measured so far, starting with the first one
+	// built, so that positions follow from indexes. The newest window comes first.
+	if (mItemExtent <= 0 && count > 0)
+	{
+		GroupMenuItem* menuItem = mGroup->mWindows.get(count - 1)->getMenuItem();
+		GtkWidget* item = GTK_WIDGET(menuItem->mItem);
+
+		if (gtk_widget_get_parent(item) == nullptr)
+			gtk_box_pack_start(GTK_BOX(mBox), item, false, true, 0);
+
+		mItemExtent = measureItem(menuItem, horizontal);
+		mFirstItem = mLastItem = mItemCount = 0;
+		mShownWindows.clear();
+	}
+
+	if (mItemExtent <= 0)
+		return;
+
+	// before the first allocation, the popup will be as large as allowed
+	double page = gtk_adjustment_get_page_size(adjustment);
+	if (page <= 0)
+		page = mMaxExtent;
+
+	double value = gtk_adjustment_get_value(adjustment);
+	uint first = MIN((uint)(value / mItemExtent), count);
+	uint last = MIN((uint)((value + page) / mItemExtent) + 1, count);
+
+	std::vector<GroupWindow*> windows;
+	mGroup->mWindows.forEach([&windows](GroupWindow* w) -> void {
+		windows.push_back(w);
+	});
+
+	// the same windows in the same order, each with its item in place
+	std::vector<GroupWindow*> shown;
+	bool placed = true;
+	for (uint position = first; position < last; ++position)
+	{
+		GroupWindow* w = windows[count - 1 - position];
+		shown.push_back(w);
+		placed = placed && w->mGroupMenuItem != nullptr && gtk_widget_get_parent(GTK_WIDGET(w->mGroupMenuItem->mItem)) == mBox;
+	}
+
+	if (first == mFirstItem && last == mLastItem && count == mItemCount && shown == mShownWindows && placed)
+		return;
+
+	mFirstItem = first;
+	mLastItem = last;
+	mItemCount = count;
+	mShownWindows = shown;
+
+	// scrolled out, the items go back to the spares
+	for (uint position = 0; position < count; ++position)
+	{
+		GroupWindow* w = windows[count - 1 - position];
+
+		if ((position < first || position >= last) && w->mGroupMenuItem != nullptr
+			&& gtk_widget_get_parent(GTK_WIDGET(w->mGroupMenuItem->mItem)) == mBox)
+			w->releaseMenuItem();
+	}
+
+	int extent = mItemExtent;
+
+	for (uint position = first; position < last; ++position)
+	{
+		GroupMenuItem* item = windows[count - 1 - position]->getMenuItem();
+		GtkWidget* widget = GTK_WIDGET(item->mItem);
+
+		if (gtk_widget_get_parent(widget) == nullptr)
 		{
-			mGroup->mWindows.forEach([](GroupWindow* w) -> void {
-				w->mGroupMenuItem->updatePreview();
-			});
-			gtk_window_resize(GTK_WINDOW(mWindow), 1, 1);
+			gtk_box_pack_start(GTK_BOX(mBox), widget, false, true, 0);
+			item->flushUpdates();
+			extent = MAX(extent, measureItem(item, horizontal));
 		}
+		else
+			item->flushUpdates();
 
-		xfce_panel_plugin_position_widget(Plugin::mXfPlugin, mWindow, mGroup->mButton, &wx, &wy);
-		updatePosition(wx, wy);
-		gtk_widget_show(mWindow);
+		gtk_box_reorder_child(GTK_BOX(mBox), widget, 1 + position - first);
 	}
+
+	// a larger item changes every position, they are worked out again with it
+	if (extent != mItemExtent)
+	{
+		mItemExtent = extent;
+		mFirstItem = mLastItem = mItemCount = 0;
+		mLayoutIdle.start();
+	}
+
+	for (uint position = first; position < last; ++position)
+	{
+		GtkWidget* widget = GTK_WIDGET(windows[count - 1 - position]->mGroupMenuItem->mItem);
+		int width, height;
+		gtk_widget_get_size_request(widget, &width, &height);
+
+		if (horizontal && width != mItemExtent)
+			gtk_widget_set_size_request(widget, mItemExtent, -1);
+		else if (!horizontal && height != mItemExtent)
+			gtk_widget_set_size_request(widget, -1, mItemExtent);
+	}
+
+	gtk_box_reorder_child(GTK_BOX(mBox), mSpacerAfter, -1);
+
+	int before = first * mItemExtent;
+	int after = (count - last) * mItemExtent;
+
+	if (horizontal)
+	{
+		gtk_widget_set_size_request(mSpacerBefore, before, -1);
+		gtk_widget_set_size_request(mSpacerAfter, after, -1);
+	}
+	else
+	{
+		gtk_widget_set_size_request(mSpacerBefore, -1, before);
+		gtk_widget_set_size_request(mSpacerAfter, -1, after);
+	}
+
+	if (mVisible && Settings::showPreviews)
+		schedulePreviews();
+}
+
+void GroupMenu::releaseItems()
+{
+	if (mVisible)
+		return;
+
+	mGroup->mWindows.forEach([](GroupWindow* w) -> void {
+		w->releaseMenuItem();
+	});
+	mFirstItem = mLastItem = mItemCount = 0;
+	mShownWindows.clear();
+}
+
+void GroupMenu::schedulePreviews()
+{
+	// The scheduler fills in what is not cached yet, within its budget, and keeps the
+	// previews fresh while the popup is open. The one under the pointer comes first.
+	mGroup->mWindows.forEach([this](GroupWindow* w) -> void {
+		GroupMenuItem* item = w->mGroupMenuItem;
+
+		if (item == nullptr || gtk_widget_get_parent(GTK_WIDGET(item->mItem)) != mBox)
+			return; // scrolled out of view
+
+		bool hovered = gtk_style_context_has_class(gtk_widget_get_style_context(GTK_WIDGET(item->mItem)), "hover_menu_item");
+
+		PreviewScheduler::setPriority(item, hovered ? PreviewScheduler::PRIORITY_HOVERED : PreviewScheduler::PRIORITY_VISIBLE);
+	});
+
+	// items scrolled into view may have been skipped while offscreen
+	PreviewScheduler::wake();
 }
 
 void GroupMenu::updateOrientation()
 {
 	XfcePanelPluginMode panelMode = xfce_panel_plugin_get_mode(Plugin::mXfPlugin);
+	GtkOrientation orientation = GTK_ORIENTATION_VERTICAL;
 
 	if (Settings::showPreviews && panelMode == XFCE_PANEL_PLUGIN_MODE_HORIZONTAL)
-		gtk_orientable_set_orientation(GTK_ORIENTABLE(mBox), GTK_ORIENTATION_HORIZONTAL);
+		orientation = GTK_ORIENTATION_HORIZONTAL;
+
+	if (gtk_orientable_get_orientation(GTK_ORIENTABLE(mBox)) != orientation)
+	{
+		gtk_orientable_set_orientation(GTK_ORIENTABLE(mBox), orientation);
+		mItemExtent = 0;
+	}
+
+	GdkRectangle workarea;
+	GdkMonitor* monitor = gdk_display_get_monitor_at_window(gtk_widget_get_display(mGroup->mButton),
+		gtk_widget_get_window(mGroup->mButton));
+	gdk_monitor_get_workarea(monitor, &workarea);
+
+	if (orientation == GTK_ORIENTATION_HORIZONTAL)
+	{
+		mMaxExtent = workarea.width;
+		gtk_scrolled_window_set_policy(GTK_SCROLLED_WINDOW(mScrolledWindow), GTK_POLICY_AUTOMATIC, GTK_POLICY_NEVER);
+		gtk_scrolled_window_set_max_content_width(GTK_SCROLLED_WINDOW(mScrolledWindow), mMaxExtent);
+		gtk_scrolled_window_set_max_content_height(GTK_SCROLLED_WINDOW(mScrolledWindow), -1);
+	}
 	else
-		gtk_orientable_set_orientation(GTK_ORIENTABLE(mBox), GTK_ORIENTATION_VERTICAL);
+	{
+		mMaxExtent = workarea.height;
+		gtk_scrolled_window_set_policy(GTK_SCROLLED_WINDOW(mScrolledWindow), GTK_POLICY_NEVER, GTK_POLICY_AUTOMATIC);
+		gtk_scrolled_window_set_max_content_width(GTK_SCROLLED_WINDOW(mScrolledWindow), -1);
+		gtk_scrolled_window_set_max_content_height(GTK_SCROLLED_WINDOW(mScrolledWindow), mMaxExtent);
+	}
 }
 
 void GroupMenu::updatePosition(gint wx, gint wy)
@@ -191,8 +410,9 @@ void GroupMenu::updatePosition(gint wx, gint wy)
 	monitor = gdk_display_get_monitor_at_window(display, gtk_widget_get_window(mGroup->mButton));
 	gdk_monitor_get_geometry(monitor, &geometry);
 
+	GtkWindow* window = PopupWindow::get();
 	gint window_width, window_height;
-	gtk_window_get_size(GTK_WINDOW(mWindow), &window_width, &window_height);
+	gtk_window_get_size(window, &window_width, &window_height);
 
 	gint button_width = gtk_widget_get_allocated_width(mGroup->mButton);
 	gint button_height = gtk_widget_get_allocated_height(mGroup->mButton);
@@ -219,51 +439,75 @@ void GroupMenu::updatePosition(gint wx, gint wy)
 #ifdef ENABLE_WAYLAND
 	if (gtk_layer_is_supported())
 	{
-		gtk_layer_set_monitor(GTK_WINDOW(mWindow), monitor);
-		gtk_layer_set_margin(GTK_WINDOW(mWindow), GTK_LAYER_SHELL_EDGE_LEFT, wx - geometry.x);
-		gtk_layer_set_margin(GTK_WINDOW(mWindow), GTK_LAYER_SHELL_EDGE_TOP, wy - geometry.y);
+		gtk_layer_set_monitor(window, monitor);
+		gtk_layer_set_margin(window, GTK_LAYER_SHELL_EDGE_LEFT, wx - geometry.x);
+		gtk_layer_set_margin(window, GTK_LAYER_SHELL_EDGE_TOP, wy - geometry.y);
 	}
 	else
 #endif
 	{
-		gtk_window_move(GTK_WINDOW(mWindow), wx, wy);
+		gtk_window_move(window, wx, wy);
 	}
+
+	// kept up to date by the popup's configure events from now on
+	mRect = {wx, wy, window_width, window_height};
 }
 
 void GroupMenu::hide()
 {
 	mVisible = false;
-	gtk_widget_hide(mWindow);
+	mPopupTime = 0;
+	PopupWindow::hide(this);
+
+	mGroup->mWindows.forEach([](GroupWindow* w) -> void {
+		PreviewScheduler::forget(w->mGroupMenuItem);
+	});
+
+	// items of a popup that is not used for a while are built again when needed
+	if (Settings::releaseMenuItems > 0)
+	{
+		mReleaseTimeout.setup(Settings::releaseMenuItems * 1000, [this]() {
+			releaseItems();
+			return false;
+		});
+		mReleaseTimeout.start();
+	}
 }
 
 void GroupMenu::showPreviewsChanged()
 {
 	mGroup->mWindows.forEach([](GroupWindow* w) -> void {
+		if (w->mGroupMenuItem == nullptr)
+			return;
+
 		gtk_widget_set_visible(GTK_WIDGET(w->mGroupMenuItem->mPreview), Settings::showPreviews);
-		w->mGroupMenuItem->mPreviewTimeout.stop();
+		gtk_widget_set_size_request(w->mGroupMenuItem->mPreview, Settings::previewWidth, Settings::previewHeight);
+		PreviewScheduler::forget(w->mGroupMenuItem);
 	});
-	gtk_window_resize(GTK_WINDOW(mWindow), 1, 1);
+	mItemExtent = 0;
+
+	if (PopupWindow::isOwner(this))
+		gtk_window_resize(PopupWindow::get(), 1, 1);
 }
 
-uint GroupMenu::getPointerDistance()
+uint GroupMenu::getPointerDistance(int x, int y)
 {
-	gint wx, wy, ww, wh, px, py;
 	guint dx, dy;
 	dx = dy = 0;
 
-	gtk_window_get_position(GTK_WINDOW(mWindow), &wx, &wy);
-	gtk_window_get_size(GTK_WINDOW(mWindow), &ww, &wh);
-	gdk_device_get_position(Plugin::mPointer, nullptr, &px, &py);
+	// the popup shows another menu, or none
+	if (!mVisible || !PopupWindow::isOwner(this))
+		return G_MAXUINT;
 
-	if (px < wx)
-		dx = wx - px;
-	else if (px > wx + ww)
-		dx = px - (wx + ww);
+	if (x < mRect.x)
+		dx = mRect.x - x;
+	else if (x > mRect.x + mRect.width)
+		dx = x - (mRect.x + mRect.width);
 
-	if (py < wy)
-		dy = wy - py;
-	else if (py > wy + wh)
-		dy = py - (wy + wh);
+	if (y < mRect.y)
+		dy = mRect.y - y;
+	else if (y > mRect.y + mRect.height)
+		dy = y - (mRect.y + mRect.height);
 
 	return std::max(dx, dy);
 }
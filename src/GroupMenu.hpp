@@ -24,9 +24,11 @@
 #include <gtk/gtk.h>
 
 #include <iostream>
+#include <vector>
 
 class Group;
 class GroupMenuItem;
+class GroupWindow;
 
 class GroupMenu
 {
@@ -34,26 +36,44 @@ public:
 	explicit GroupMenu(Group* dockButton);
 	~GroupMenu();
 
-	void add(GroupMenuItem* menuItem);
-	void remove(GroupMenuItem* menuItem);
+	void add(GroupWindow* window);
+	void remove(GroupWindow* window);
 
 	void popup();
+	void layoutItems();
+	void releaseItems();
 	void updateOrientation();
 	void updatePosition(gint wx, gint wy);
 	void hide();
 	void showPreviewsChanged();
+	void schedulePreviews();
 
-	uint getPointerDistance();
+	uint getPointerDistance(int x, int y);
 
 	Group* mGroup;
 
-	GtkWidget* mWindow;
+	// shown in the shared popup window
+	GtkWidget* mScrolledWindow;
 	GtkWidget* mBox;
 
+	// Only the items in view are built, the space of the others is taken by the spacers
+	GtkWidget* mSpacerBefore;
+	GtkWidget* mSpacerAfter;
+	int mItemExtent;
+	int mMaxExtent;
+	uint mFirstItem;
+	uint mLastItem;
+	uint mItemCount;
+	std::vector<GroupWindow*> mShownWindows; // from mFirstItem to mLastItem, compared only
+
 	bool mVisible;
 	bool mMouseHover;
+	GdkRectangle mRect; // last known popup geometry, in root coordinates
 
 	Help::Gtk::Idle mPopupIdle;
+	Help::Gtk::Idle mLayoutIdle;
+	Help::Gtk::Timeout mReleaseTimeout;
+	gint64 mPopupTime;
 };
 
 #endif // GROUP_MENU_HPP
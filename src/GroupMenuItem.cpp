@@ -16,18 +16,28 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
-#ifdef ENABLE_X11
-#include <gdk/gdkx.h>
-#include <libxfce4windowing/xfw-x11.h>
-#endif
-
 #include "GroupMenuItem.hpp"
+#include "PreviewCache.hpp"
+#include "PreviewPipeline.hpp"
+#include "PreviewScheduler.hpp"
+#include "Trace.hpp"
+#include "WindowCapture.hpp"
+#include "WindowIcons.hpp"
 
 static GtkTargetEntry entries[1] = {{(gchar*)"any", 0, 0}};
 
+// Items of windows scrolled out of a popup or released after it closed, ready to be bound again
+static std::vector<GroupMenuItem*> mSpareItems;
+static const size_t mMaxSpareItems = 32;
+
+// fastest title and icon refresh of an open popup
+static const gint64 mUpdateInterval = 250;
+static uint mUpdatesApplied = 0;
+static uint mUpdatesSuppressed = 0;
+
 GroupMenuItem::GroupMenuItem(GroupWindow* groupWindow)
 {
-	mGroupWindow = groupWindow;
+	mGroupWindow = nullptr;
 
 	// This needs work to survive porting to GTK4.
 	// GtkEventBox is removed, all events are supported by all widgets.
@@ -66,22 +76,17 @@ GroupMenuItem::GroupMenuItem(GroupWindow* groupWindow)
 	gtk_widget_show(GTK_WIDGET(mCloseButton));
 	gtk_grid_attach(mGrid, GTK_WIDGET(mCloseButton), 2, 0, 1, 1);
 
-	mPreview = GTK_IMAGE(gtk_image_new());
-	Help::Gtk::cssClassAdd(GTK_WIDGET(mPreview), "preview");
-	gtk_grid_attach(mGrid, GTK_WIDGET(mPreview), 0, 1, 3, 1);
-	gtk_widget_set_visible(GTK_WIDGET(mPreview), Settings::showPreviews);
-
-	if (Xfw::getActiveWindow() == mGroupWindow->mXfwWindow)
-		Help::Gtk::cssClassAdd(GTK_WIDGET(mItem), "active_menu_item");
-
-	int sleepMS = 1000;
-	if (Settings::previewSleep)
-		sleepMS = Settings::previewSleep;
+	// Previews are painted from the preview cache, so that a popup shows the last known
+	// content of its windows right away, while newer captures are on their way.
+	mPreview = gtk_drawing_area_new();
+	mSpareSurface = nullptr;
+	mPlaceholder = nullptr;
+	mLabelDirty = mIconDirty = false;
+	mUpdateTime = 0;
+	Help::Gtk::cssClassAdd(mPreview, "preview");
+	gtk_grid_attach(mGrid, mPreview, 0, 1, 3, 1);
 
-	mPreviewTimeout.setup(sleepMS, [this]() {
-		updatePreview();
-		return true;
-	});
+	bind(groupWindow);
 
 	//--------------------------------------------------
 
@@ -115,6 +120,9 @@ GroupMenuItem::GroupMenuItem(GroupWindow* groupWindow)
 				me->mGroupWindow->activate(event->time);
 			Help::Gtk::cssClassAdd(widget, "hover_menu_item");
 			gtk_widget_queue_draw(widget);
+
+			if (Settings::showPreviews)
+				PreviewScheduler::setPriority(me, PreviewScheduler::PRIORITY_HOVERED);
 			return true;
 		}),
 		this);
@@ -124,10 +132,35 @@ GroupMenuItem::GroupMenuItem(GroupWindow* groupWindow)
 			Help::Gtk::cssClassRemove(widget, "hover_menu_item");
 			gtk_widget_queue_draw(widget);
 			gtk_widget_queue_draw(me->mGroupWindow->mGroup->mButton);
+
+			if (Settings::showPreviews && me->mGroupWindow->mGroup->mGroupMenu.mVisible)
+				PreviewScheduler::setPriority(me, PreviewScheduler::PRIORITY_VISIBLE);
 			return true;
 		}),
 		this);
 
+	g_signal_connect(G_OBJECT(mPreview), "draw",
+		G_CALLBACK(+[](GtkWidget* widget, cairo_t* cr, GroupMenuItem* me) {
+			cairo_surface_t* surface = PreviewCache::lookup(me->mGroupWindow->mXfwWindow);
+			if (surface != nullptr)
+			{
+				cairo_set_source_surface(cr, surface, 0, 0);
+				cairo_paint(cr);
+				return false;
+			}
+
+			// placeholder until the first capture: the window icon, centered
+			cairo_surface_t* placeholder = me->getPlaceholder(gtk_widget_get_scale_factor(widget));
+			if (placeholder != nullptr)
+			{
+				cairo_set_source_surface(cr, placeholder,
+					(gtk_widget_get_allocated_width(widget) - 32) / 2, (gtk_widget_get_allocated_height(widget) - 32) / 2);
+				cairo_paint_with_alpha(cr, 0.5);
+			}
+			return false;
+		}),
+		this);
+
 	g_signal_connect(G_OBJECT(mCloseButton), "clicked",
 		G_CALLBACK(+[](GtkButton* button, GroupMenuItem* me) {
 			Xfw::close(me->mGroupWindow, 0);
@@ -137,8 +170,119 @@ GroupMenuItem::GroupMenuItem(GroupWindow* groupWindow)
 
 GroupMenuItem::~GroupMenuItem()
 {
-	mPreviewTimeout.stop();
+	unbind();
 	g_object_unref(mItem);
+
+	if (mSpareSurface != nullptr)
+		cairo_surface_destroy(mSpareSurface);
+	dropPlaceholder();
+}
+
+GroupMenuItem* GroupMenuItem::obtain(GroupWindow* groupWindow)
+{
+	if (mSpareItems.empty())
+		return new GroupMenuItem(groupWindow);
+
+	GroupMenuItem* item = mSpareItems.back();
+	mSpareItems.pop_back();
+	item->bind(groupWindow);
+
+	return item;
+}
+
+void GroupMenuItem::recycle(GroupMenuItem* item)
+{
+	GtkWidget* parent = gtk_widget_get_parent(GTK_WIDGET(item->mItem));
+	if (parent != nullptr)
+		gtk_container_remove(GTK_CONTAINER(parent), GTK_WIDGET(item->mItem));
+
+	if (mSpareItems.size() >= mMaxSpareItems)
+	{
+		delete item;
+		return;
+	}
+
+	item->unbind();
+	mSpareItems.push_back(item);
+}
+
+void GroupMenuItem::finalize()
+{
+	if (mUpdatesApplied + mUpdatesSuppressed > 0)
+		g_debug("Menu items: %u title and icon updates applied, %u suppressed or merged", mUpdatesApplied, mUpdatesSuppressed);
+	mUpdatesApplied = mUpdatesSuppressed = 0;
+
+	for (GroupMenuItem* item : mSpareItems)
+		delete item;
+
+	mSpareItems.clear();
+}
+
+void GroupMenuItem::bind(GroupWindow* groupWindow)
+{
+	mGroupWindow = groupWindow;
+	mPreviewDirty = true;
+	mPreviewTime = 0;
+
+	// settings may have changed while the item was spare
+	gtk_widget_set_visible(mPreview, Settings::showPreviews);
+	gtk_widget_set_size_request(mPreview, Settings::previewWidth, Settings::previewHeight);
+
+	if (Xfw::getActiveWindow() == mGroupWindow->mXfwWindow)
+		Help::Gtk::cssClassAdd(GTK_WIDGET(mItem), "active_menu_item");
+
+	WindowCapture::watch(mGroupWindow->mXfwWindow, [this]() {
+		mPreviewDirty = true;
+		PreviewScheduler::wake();
+	});
+
+	gtk_widget_queue_draw(mPreview);
+}
+
+void GroupMenuItem::unbind()
+{
+	if (mGroupWindow == nullptr)
+		return;
+
+	PreviewScheduler::forget(this);
+	WindowCapture::unwatch(mGroupWindow->mXfwWindow);
+	PreviewPipeline::forget(this);
+
+	mUpdateTimeout.stop();
+	mLabelDirty = mIconDirty = false;
+
+	Help::Gtk::cssClassRemove(GTK_WIDGET(mItem), "active_menu_item");
+	Help::Gtk::cssClassRemove(GTK_WIDGET(mItem), "hover_menu_item");
+	gtk_image_clear(mIcon);
+	dropPlaceholder();
+	mGroupWindow = nullptr;
+}
+
+cairo_surface_t* GroupMenuItem::getPlaceholder(int scale)
+{
+	double xScale, yScale;
+	if (mPlaceholder != nullptr)
+	{
+		cairo_surface_get_device_scale(mPlaceholder, &xScale, &yScale);
+		if (xScale != scale)
+			dropPlaceholder();
+	}
+
+	if (mPlaceholder == nullptr)
+	{
+		GdkPixbuf* icon = xfw_window_get_icon(mGroupWindow->mXfwWindow, 32, scale);
+		if (icon != nullptr)
+			mPlaceholder = WindowIcons::get(icon, scale);
+	}
+
+	return mPlaceholder;
+}
+
+void GroupMenuItem::dropPlaceholder()
+{
+	if (mPlaceholder != nullptr)
+		cairo_surface_destroy(mPlaceholder);
+	mPlaceholder = nullptr;
 }
 
 void GroupMenuItem::updateLabel()
@@ -172,85 +316,158 @@ void GroupMenuItem::updateIcon()
 
 	if (iconPixbuf != nullptr)
 	{
-		cairo_surface_t* surface = gdk_cairo_surface_create_from_pixbuf(iconPixbuf, scale_factor, nullptr);
+		cairo_surface_t* surface = WindowIcons::get(iconPixbuf, scale_factor);
 		gtk_image_set_from_surface(mIcon, surface);
 		cairo_surface_destroy(surface);
 	}
+
+	// built again from the new icon on the next draw
+	if (mPlaceholder != nullptr)
+	{
+		dropPlaceholder();
+		gtk_widget_queue_draw(mPreview);
+	}
+}
+
+void GroupMenuItem::queueLabelUpdate()
+{
+	mLabelDirty = true;
+	flushUpdates();
+}
+
+void GroupMenuItem::queueIconUpdate()
+{
+	mIconDirty = true;
+	flushUpdates();
+}
+
+void GroupMenuItem::flushUpdates()
+{
+	if (!mLabelDirty && !mIconDirty)
+		return;
+
+	// Nobody sees the item and the popup applies the changes when it shows,
+	// or a refresh is coming already and will include them.
+	if (!mGroupWindow->mGroup->mGroupMenu.mVisible || mUpdateTimeout.mTimeoutId != 0)
+	{
+		++mUpdatesSuppressed;
+		return;
+	}
+
+	gint64 elapsed = (g_get_monotonic_time() - mUpdateTime) / 1000;
+
+	if (elapsed < mUpdateInterval)
+	{
+		++mUpdatesSuppressed;
+		mUpdateTimeout.setup(mUpdateInterval - elapsed, [this]() {
+			// not pending anymore, so the flush applies the changes
+			mUpdateTimeout.stop();
+			flushUpdates();
+			return false;
+		});
+		mUpdateTimeout.start();
+		return;
+	}
+
+	if (mLabelDirty)
+		updateLabel();
+	if (mIconDirty)
+		updateIcon();
+
+	++mUpdatesApplied;
+	mLabelDirty = mIconDirty = false;
+	mUpdateTime = g_get_monotonic_time();
+}
+
+cairo_surface_t* GroupMenuItem::takePreviewTarget()
+{
+	gint scale_factor = gtk_widget_get_scale_factor(mPreview);
+	gint width = Settings::previewWidth * scale_factor;
+	gint height = Settings::previewHeight * scale_factor;
+	cairo_surface_t* surface = mSpareSurface;
+
+	mSpareSurface = nullptr;
+
+	if (surface != nullptr
+		&& cairo_image_surface_get_width(surface) == width
+		&& cairo_image_surface_get_height(surface) == height)
+		return surface;
+
+	if (surface != nullptr)
+		cairo_surface_destroy(surface);
+
+	surface = cairo_image_surface_create(CAIRO_FORMAT_ARGB32, width, height);
+	if (cairo_surface_status(surface) != CAIRO_STATUS_SUCCESS)
+	{
+		cairo_surface_destroy(surface);
+		return nullptr;
+	}
+
+	cairo_surface_set_device_scale(surface, scale_factor, scale_factor);
+	return surface;
+}
+
+void GroupMenuItem::recyclePreviewTarget(cairo_surface_t* surface)
+{
+	if (mSpareSurface != nullptr)
+		cairo_surface_destroy(mSpareSurface);
+
+	mSpareSurface = surface;
+}
+
+void GroupMenuItem::presentPreview(cairo_surface_t* surface)
+{
+	// the surface on screen until now is refilled by the next update
+	recyclePreviewTarget(PreviewCache::store(mGroupWindow->mXfwWindow, surface));
+	gtk_widget_queue_draw(mPreview);
+}
+
+bool GroupMenuItem::previewOutdated()
+{
+	// without change tracking, a window may always have changed
+	return mPreviewDirty || !WindowCapture::damageAvailable() || !PreviewCache::contains(mGroupWindow->mXfwWindow);
+}
+
+bool GroupMenuItem::previewOnScreen()
+{
+	if (!gtk_widget_is_drawable(mPreview))
+		return false;
+
+	GtkWidget* toplevel = gtk_widget_get_toplevel(mPreview);
+	GdkWindow* window = gtk_widget_get_window(toplevel);
+	GdkRectangle rect, geometry;
+	gint ox, oy;
+
+	if (window == nullptr || !gtk_widget_translate_coordinates(mPreview, toplevel, 0, 0, &rect.x, &rect.y))
+		return false;
+
+	gdk_window_get_origin(window, &ox, &oy);
+	rect.x += ox;
+	rect.y += oy;
+	rect.width = gtk_widget_get_allocated_width(mPreview);
+	rect.height = gtk_widget_get_allocated_height(mPreview);
+
+	GdkMonitor* monitor = gdk_display_get_monitor_at_window(gdk_window_get_display(window), window);
+	gdk_monitor_get_geometry(monitor, &geometry);
+
+	return gdk_rectangle_intersect(&rect, &geometry, nullptr);
 }
 
 void GroupMenuItem::updatePreview()
 {
+	TRACE_SPAN("GroupMenuItem::updatePreview");
+
 	if (mGroupWindow->getState(XFW_WINDOW_STATE_MINIMIZED))
 		return; // minimized windows never need a new thumbnail
 
-#ifdef ENABLE_X11
-	// This needs work to survive porting to GTK4 and/or Wayland.
-	// GDK doesn't expose an API to get a foreign window on X11 anymore (so X11 code).
-	// Wayland may never have a public protocol for obtaining a preview of a foreign window,
-	// which goes against its security principles (so private protocol).
-	if (GDK_IS_X11_DISPLAY(Plugin::mDisplay))
+	// nothing was drawn in the window since the preview we have
+	if (!previewOutdated())
 	{
-		GdkWindow* window;
-		GdkPixbuf* pixbuf;
-		GdkPixbuf* thumbnail;
-
-		window = gdk_x11_window_foreign_new_for_display(Plugin::mDisplay,
-			xfw_window_x11_get_xid(mGroupWindow->mXfwWindow));
-
-		if (window != nullptr)
-		{
-			// we're probably not doing anything wrong at our level, but things can go wrong in cairo when
-			// multiple windows are closed and thumbnails are shown (#71), so let's catch X11 errors for it
-			GdkDisplay* display = gdk_display_get_default();
-			gdk_x11_display_error_trap_push(display);
-			pixbuf = gdk_pixbuf_get_from_window(window, 0, 0, gdk_window_get_width(window), gdk_window_get_height(window));
-			gdk_x11_display_error_trap_pop_ignored(display);
-
-			if (pixbuf != nullptr)
-			{
-				gint scale_factor = gtk_widget_get_scale_factor(GTK_WIDGET(mPreview));
-
-				gint previewWidth = Settings::previewWidth * scale_factor;
-				gint previewHeight = Settings::previewHeight * scale_factor;
-
-				gint pixbufWidth = gdk_pixbuf_get_width(pixbuf);
-				gint pixbufHeight = gdk_pixbuf_get_height(pixbuf);
-
-				/* calculate the new dimensions */
-				gdouble wRatio = (gdouble)pixbufWidth / (gdouble)previewWidth;
-				gdouble hRatio = (gdouble)pixbufHeight / (gdouble)previewHeight;
-
-				if (hRatio > wRatio)
-				{
-					pixbufWidth = MAX(1, pixbufWidth / hRatio);
-					pixbufHeight = MIN(pixbufHeight, previewHeight);
-				}
-				else
-				{
-					pixbufWidth = MIN(pixbufWidth, previewWidth);
-					pixbufHeight = MAX(1, pixbufHeight / wRatio);
-				}
-
-				thumbnail = gdk_pixbuf_scale_simple(pixbuf, pixbufWidth, pixbufHeight, GDK_INTERP_BILINEAR);
-
-				GdkPixbuf* sized = gdk_pixbuf_new(GDK_COLORSPACE_RGB, true, 8, previewWidth, previewHeight);
-				gint thumbWidth = gdk_pixbuf_get_width(thumbnail);
-				gint thumbHeight = gdk_pixbuf_get_height(thumbnail);
-				gint xOffset = (previewWidth - thumbWidth) / 2;
-				gint yOffset = (previewHeight - thumbHeight) / 2;
-				gdk_pixbuf_composite(thumbnail, sized, xOffset, yOffset, thumbWidth, thumbHeight, xOffset, yOffset, 1, 1, GDK_INTERP_BILINEAR, 255);
-
-				cairo_surface_t* surface = gdk_cairo_surface_create_from_pixbuf(sized, scale_factor, nullptr);
-
-				gtk_image_set_from_surface(mPreview, surface);
-
-				cairo_surface_destroy(surface);
-				g_object_unref(sized);
-				g_object_unref(thumbnail);
-				g_object_unref(pixbuf);
-			}
-			g_object_unref(window);
-		}
+		PreviewPipeline::countSkipped();
+		return;
 	}
-#endif
+
+	mPreviewDirty = false;
+	mPreviewTime = g_get_monotonic_time();
+	PreviewPipeline::request(this);
 }
@@ -26,6 +26,7 @@
 #include <gtk/gtk.h>
 
 #include <iostream>
+#include <vector>
 
 class GroupWindow;
 
@@ -35,9 +36,29 @@ public:
 	explicit GroupMenuItem(GroupWindow* groupWindow);
 	~GroupMenuItem();
 
+	// Items are reused for other windows rather than rebuilt
+	static GroupMenuItem* obtain(GroupWindow* groupWindow);
+	static void recycle(GroupMenuItem* item);
+	static void finalize();
+
+	void bind(GroupWindow* groupWindow);
+	void unbind();
+
 	void updateLabel();
 	void updateIcon();
+
+	// Title and icon changes are applied when the popup shows, at a limited rate while it is open
+	void queueLabelUpdate();
+	void queueIconUpdate();
+	void flushUpdates();
 	void updatePreview();
+	bool previewOutdated();
+	bool previewOnScreen();
+	cairo_surface_t* takePreviewTarget();
+	void recyclePreviewTarget(cairo_surface_t* surface);
+	void presentPreview(cairo_surface_t* surface);
+	cairo_surface_t* getPlaceholder(int scale);
+	void dropPlaceholder();
 
 	GroupWindow* mGroupWindow;
 
@@ -46,9 +67,18 @@ public:
 	GtkImage* mIcon;
 	GtkLabel* mLabel;
 	GtkButton* mCloseButton;
-	GtkImage* mPreview;
+	GtkWidget* mPreview;
+	cairo_surface_t* mSpareSurface;
+	cairo_surface_t* mPlaceholder; // the window icon, shown until the first preview
+
+	bool mLabelDirty;
+	bool mIconDirty;
+	gint64 mUpdateTime;
+	Help::Gtk::Timeout mUpdateTimeout;
 
-	Help::Gtk::Timeout mPreviewTimeout;
+	// refreshes are timed by the preview scheduler
+	bool mPreviewDirty;
+	gint64 mPreviewTime;
 };
 
 #endif // GROUP_MENU_ITEM_HPP
@@ -17,11 +17,12 @@
  */
 
 #include "GroupWindow.hpp"
+#include "Audit.hpp"
 
 GroupWindow::GroupWindow(XfwWindow* xfwWindow)
 {
 	mXfwWindow = xfwWindow;
-	mGroupMenuItem = new GroupMenuItem(this);
+	mGroupMenuItem = nullptr;
 	mGroupAssociated = false;
 
 	std::string groupName = Xfw::getGroupName(this);
@@ -35,31 +36,38 @@ GroupWindow::GroupWindow(XfwWindow* xfwWindow)
 
 	g_signal_connect(G_OBJECT(mXfwWindow), "name-changed",
 		G_CALLBACK(+[](XfwWindow* window, GroupWindow* me) {
-			me->mGroupMenuItem->updateLabel();
+			Audit::Scope audit(Audit::KIND_SIGNAL, "xfw window name-changed");
+			if (me->mGroupMenuItem != nullptr)
+				me->mGroupMenuItem->queueLabelUpdate();
 		}),
 		this);
 
 	g_signal_connect(G_OBJECT(mXfwWindow), "icon-changed",
 		G_CALLBACK(+[](XfwWindow* window, GroupWindow* me) {
-			me->mGroupMenuItem->updateIcon();
+			Audit::Scope audit(Audit::KIND_SIGNAL, "xfw window icon-changed");
+			if (me->mGroupMenuItem != nullptr)
+				me->mGroupMenuItem->queueIconUpdate();
 		}),
 		this);
 
 	g_signal_connect(G_OBJECT(mXfwWindow), "state-changed",
 		G_CALLBACK(+[](XfwWindow* window, XfwWindowState changed_mask,
 						XfwWindowState new_state, GroupWindow* me) {
+			Audit::Scope audit(Audit::KIND_SIGNAL, "xfw window state-changed");
 			me->updateState();
 		}),
 		this);
 
 	g_signal_connect(G_OBJECT(mXfwWindow), "workspace-changed",
 		G_CALLBACK(+[](XfwWindow* window, GroupWindow* me) {
+			Audit::Scope audit(Audit::KIND_SIGNAL, "xfw window workspace-changed");
 			me->updateState();
 		}),
 		this);
 
 	g_signal_connect(G_OBJECT(mXfwWindow), "notify::monitors",
 		G_CALLBACK(+[](XfwWindow* window, GParamSpec* pspec, GroupWindow* me) {
+			Audit::Scope audit(Audit::KIND_SIGNAL, "xfw window notify::monitors");
 			me->updateState();
 			Xfw::setActiveWindow();
 		}),
@@ -67,6 +75,7 @@ GroupWindow::GroupWindow(XfwWindow* xfwWindow)
 
 	g_signal_connect(G_OBJECT(mXfwWindow), "class-changed",
 		G_CALLBACK(+[](XfwWindow* window, GroupWindow* me) {
+			Audit::Scope audit(Audit::KIND_SIGNAL, "xfw window class-changed");
 			std::string _groupName = Xfw::getGroupName(me);
 			Group* group = Dock::prepareGroup(AppInfos::search(_groupName));
 			if (group != me->mGroup)
@@ -80,8 +89,6 @@ GroupWindow::GroupWindow(XfwWindow* xfwWindow)
 		this);
 
 	updateState();
-	mGroupMenuItem->updateIcon();
-	mGroupMenuItem->updateLabel();
 }
 
 bool GroupWindow::getState(XfwWindowState flagMask) const
@@ -103,7 +110,27 @@ GroupWindow::~GroupWindow()
 {
 	leaveGroup();
 	g_signal_handlers_disconnect_by_data(this->mXfwWindow, this);
-	delete mGroupMenuItem;
+	releaseMenuItem();
+}
+
+GroupMenuItem* GroupWindow::getMenuItem()
+{
+	if (mGroupMenuItem == nullptr)
+	{
+		mGroupMenuItem = GroupMenuItem::obtain(this);
+		mGroupMenuItem->updateIcon();
+		mGroupMenuItem->updateLabel();
+	}
+
+	return mGroupMenuItem;
+}
+
+void GroupWindow::releaseMenuItem()
+{
+	if (mGroupMenuItem != nullptr)
+		GroupMenuItem::recycle(mGroupMenuItem);
+
+	mGroupMenuItem = nullptr;
 }
 
 void GroupWindow::getInGroup()
@@ -124,8 +151,11 @@ void GroupWindow::leaveGroup()
 
 void GroupWindow::onActivate()
 {
-	gtk_widget_queue_draw(GTK_WIDGET(mGroupMenuItem->mItem));
-	mGroupMenuItem->updateLabel();
+	if (mGroupMenuItem != nullptr)
+	{
+		gtk_widget_queue_draw(GTK_WIDGET(mGroupMenuItem->mItem));
+		mGroupMenuItem->queueLabelUpdate();
+	}
 
 	if (mGroupAssociated)
 		mGroup->onWindowActivate(this);
@@ -133,8 +163,11 @@ void GroupWindow::onActivate()
 
 void GroupWindow::onUnactivate() const
 {
-	gtk_widget_queue_draw(GTK_WIDGET(mGroupMenuItem->mItem));
-	mGroupMenuItem->updateLabel();
+	if (mGroupMenuItem != nullptr)
+	{
+		gtk_widget_queue_draw(GTK_WIDGET(mGroupMenuItem->mItem));
+		mGroupMenuItem->queueLabelUpdate();
+	}
 
 	if (mGroupAssociated)
 		mGroup->onWindowUnactivate();
@@ -179,6 +212,4 @@ void GroupWindow::updateState()
 		getInGroup();
 	else
 		leaveGroup();
-
-	gtk_widget_show(GTK_WIDGET(mGroupMenuItem->mItem));
 }
@@ -50,7 +50,11 @@ public:
 	void activate(guint32 timestamp);
 	bool getState(XfwWindowState flagMask) const;
 
+	GroupMenuItem* getMenuItem();
+	void releaseMenuItem();
+
 	Group* mGroup;
+	// built when a popup first needs it, nullptr until then
 	GroupMenuItem* mGroupMenuItem;
 
 	XfwWindow* mXfwWindow;
@@ -17,6 +17,9 @@
  */
 
 #include "Helpers.hpp"
+#include "Audit.hpp"
+
+#include <map>
 
 namespace Help
 {
@@ -178,60 +181,395 @@ namespace Help
 			gtk_style_context_remove_class(gtk_widget_get_style_context(widget), className);
 		}
 
-		Timeout::Timeout() : mDuration(0), mTimeoutId(0) {}
+		namespace Wheel
+		{
+			const uint MAX_SLACK = 50;
+
+			// ticks in monotonic µs, each holding the timers due then with their ids
+			std::map<gint64, std::vector<std::pair<Timeout*, uint>>>* mTicks = nullptr;
+			// the timers taken out by the running wakeup, cleared here when stopped meanwhile
+			std::vector<std::pair<Timeout*, uint>>* mDue = nullptr;
+			uint mSourceId = 0;
+			gint64 mSourceTick = 0;
+			uint mLastId = 0;
+
+			uint mWakeups = 0;
+			uint mExpirations = 0;
+
+			static bool onWakeup();
+
+			static void arm()
+			{
+				if (mTicks->empty())
+				{
+					if (mSourceId != 0)
+						g_source_remove(mSourceId);
+					mSourceId = 0;
+					return;
+				}
+
+				gint64 tick = mTicks->begin()->first;
+				if (mSourceId != 0 && mSourceTick <= tick)
+					return;
+
+				if (mSourceId != 0)
+					g_source_remove(mSourceId);
+
+				gint64 delay = std::max<gint64>(tick - g_get_monotonic_time() + 999, 0) / 1000;
+				mSourceTick = tick;
+				mSourceId = g_timeout_add(delay, G_SOURCE_FUNC(+[](gpointer) {
+					mSourceId = 0;
+					onWakeup();
+					return G_SOURCE_REMOVE;
+				}),
+					nullptr);
+			}
+
+			static void insert(Timeout* timeout)
+			{
+				if (mTicks == nullptr)
+					mTicks = new std::map<gint64, std::vector<std::pair<Timeout*, uint>>>();
+
+				// A slack rounded down to a power of two puts the tick on a grid that the
+				// other timers' grids either share or subdivide.
+				gint64 deadline = g_get_monotonic_time() + (gint64)timeout->mDuration * 1000;
+				gint64 grid = 1000;
+				while (grid * 2 <= (gint64)timeout->mSlack * 1000)
+					grid *= 2;
+
+				timeout->mTick = timeout->mSlack == 0 ? deadline : (deadline + grid - 1) / grid * grid;
+				(*mTicks)[timeout->mTick].emplace_back(timeout, timeout->mTimeoutId);
+				arm();
+			}
+
+			static void remove(Timeout* timeout)
+			{
+				if (mDue != nullptr)
+					for (auto& timer : *mDue)
+						if (timer.first == timeout && timer.second == timeout->mTimeoutId)
+							timer.first = nullptr;
+
+				if (mTicks == nullptr)
+					return;
+
+				auto it = mTicks->find(timeout->mTick);
+				if (it == mTicks->end())
+					return;
+
+				auto& timers = it->second;
+				timers.erase(std::remove_if(timers.begin(), timers.end(), [timeout](const std::pair<Timeout*, uint>& timer) {
+					return timer.first == timeout && timer.second == timeout->mTimeoutId;
+				}),
+					timers.end());
+
+				if (timers.empty())
+				{
+					mTicks->erase(it);
+					arm();
+				}
+			}
+
+			static bool onWakeup()
+			{
+				++mWakeups;
 
-		void Timeout::setup(uint ms, std::function<bool()> function)
+				// taken out first, as the callbacks may start or stop timers
+				gint64 now = g_get_monotonic_time();
+				std::vector<std::pair<Timeout*, uint>> due;
+
+				while (!mTicks->empty() && mTicks->begin()->first <= now)
+				{
+					auto& timers = mTicks->begin()->second;
+					due.insert(due.end(), timers.begin(), timers.end());
+					mTicks->erase(mTicks->begin());
+				}
+
+				// A timer stopped, restarted or destroyed by a callback, its own included, is
+				// cleared from the list by remove() and never touched again.
+				mDue = &due;
+
+				for (uint i = 0; i < due.size(); ++i)
+				{
+					Timeout* timeout = due[i].first;
+					if (timeout == nullptr)
+						continue;
+
+					// copied, the callback may free or set up the timer
+					std::function<bool()> function = timeout->mFunction;
+					const char* file = timeout->mFile;
+					int line = timeout->mLine;
+
+					++mExpirations;
+					gint64 start = g_get_monotonic_time();
+					bool cont = function();
+					Audit::record(Audit::KIND_TIMEOUT, file, line, g_get_monotonic_time() - start);
+
+					if (due[i].first == nullptr)
+						continue;
+
+					if (cont)
+						insert(timeout);
+					else
+						timeout->mTimeoutId = 0;
+				}
+
+				mDue = nullptr;
+				arm();
+				return false;
+			}
+		} // namespace Wheel
+
+		namespace Jobs
+		{
+			// about half a frame at 60 Hz, the rest is left to input and drawing
+			const gint64 BUDGET = 8000;
+
+			struct Job
+			{
+				const void* key;
+				std::function<bool()> slice;
+				const char* file;
+				int line;
+			};
+
+			struct Queue
+			{
+				std::list<Job> jobs[JOB_LOW + 1];
+				std::map<const void*, std::pair<JobPriority, std::list<Job>::iterator>> index;
+			};
+
+			Queue* mQueue = nullptr;
+			uint mSourceId = 0;
+			const void* mRunningKey = nullptr;
+			bool mRunningCancelled = false;
+			uint mLastIdleId = 0;
+
+			uint mSlices = 0;
+			uint mDispatches = 0;
+			uint mOverruns = 0;
+			uint mMaxDepth = 0;
+			gint64 mLongestSlice = 0;
+
+			static void push(const void* key, JobPriority priority, std::function<bool()> slice, const char* file, int line)
+			{
+				std::list<Job>& jobs = mQueue->jobs[priority];
+				jobs.push_back({key, std::move(slice), file, line});
+				mQueue->index[key] = {priority, std::prev(jobs.end())};
+				mMaxDepth = std::max<uint>(mMaxDepth, mQueue->index.size());
+			}
+
+			static gboolean dispatch(gpointer)
+			{
+				gint64 start = g_get_monotonic_time();
+				gint64 now = start;
+				++mDispatches;
+
+				while (now - start < BUDGET)
+				{
+					int priority = JOB_HIGH;
+					while (priority <= JOB_LOW && mQueue->jobs[priority].empty())
+						++priority;
+
+					if (priority > JOB_LOW)
+						break;
+
+					Job job = std::move(mQueue->jobs[priority].front());
+					mQueue->jobs[priority].pop_front();
+					mQueue->index.erase(job.key);
+
+					// the slice may queue or cancel its own key again
+					mRunningKey = job.key;
+					mRunningCancelled = false;
+
+					bool cont = job.slice();
+
+					mRunningKey = nullptr;
+					++mSlices;
+
+					gint64 end = g_get_monotonic_time();
+					Audit::record(Audit::KIND_IDLE, job.file, job.line, end - now);
+					mLongestSlice = std::max(mLongestSlice, end - now);
+					if (end - now > BUDGET)
+						++mOverruns;
+					now = end;
+
+					if (cont && !mRunningCancelled && mQueue->index.count(job.key) == 0)
+						push(job.key, (JobPriority)priority, std::move(job.slice), job.file, job.line);
+				}
+
+				if (mQueue->index.empty())
+				{
+					mSourceId = 0;
+					return G_SOURCE_REMOVE;
+				}
+
+				return G_SOURCE_CONTINUE;
+			}
+		} // namespace Jobs
+
+		void queueJob(const void* key, JobPriority priority, std::function<bool()> slice, const char* file, int line)
+		{
+			if (Jobs::mQueue == nullptr)
+				Jobs::mQueue = new Jobs::Queue();
+
+			auto it = Jobs::mQueue->index.find(key);
+
+			if (it != Jobs::mQueue->index.end() && it->second.first == priority)
+			{
+				it->second.second->slice = std::move(slice);
+				it->second.second->file = file;
+				it->second.second->line = line;
+			}
+			else
+			{
+				if (it != Jobs::mQueue->index.end())
+					cancelJob(key);
+
+				Jobs::push(key, priority, std::move(slice), file, line);
+			}
+
+			if (Jobs::mSourceId == 0)
+				Jobs::mSourceId = g_idle_add(Jobs::dispatch, nullptr);
+		}
+
+		void cancelJob(const void* key)
+		{
+			if (Jobs::mQueue == nullptr)
+				return;
+
+			if (key == Jobs::mRunningKey)
+				Jobs::mRunningCancelled = true;
+
+			auto it = Jobs::mQueue->index.find(key);
+			if (it == Jobs::mQueue->index.end())
+				return;
+
+			Jobs::mQueue->jobs[it->second.first].erase(it->second.second);
+			Jobs::mQueue->index.erase(it);
+		}
+
+		bool isJobQueued(const void* key)
+		{
+			return Jobs::mQueue != nullptr && Jobs::mQueue->index.count(key) != 0;
+		}
+
+		uint getJobQueueDepth()
+		{
+			return Jobs::mQueue != nullptr ? Jobs::mQueue->index.size() : 0;
+		}
+
+		uint getJobOverruns()
+		{
+			return Jobs::mOverruns;
+		}
+
+		uint getWakeups()
+		{
+			return Wheel::mWakeups + Jobs::mDispatches;
+		}
+
+		void finalize()
+		{
+			g_debug("Timer wheel: %u wakeups for %u expirations", Wheel::mWakeups, Wheel::mExpirations);
+			g_debug("Job queue: %u slices in %u iterations, %u over budget, longest %" G_GINT64_FORMAT " us, up to %u queued",
+				Jobs::mSlices, Jobs::mDispatches, Jobs::mOverruns, Jobs::mLongestSlice, Jobs::mMaxDepth);
+
+			if (Wheel::mSourceId != 0)
+				g_source_remove(Wheel::mSourceId);
+			if (Jobs::mSourceId != 0)
+				g_source_remove(Jobs::mSourceId);
+
+			Wheel::mSourceId = Jobs::mSourceId = 0;
+			Wheel::mWakeups = Wheel::mExpirations = 0;
+			Jobs::mSlices = Jobs::mDispatches = Jobs::mOverruns = Jobs::mMaxDepth = 0;
+			Jobs::mLongestSlice = 0;
+
+			// still armed timers and queued jobs are forgotten, stopping them later is harmless
+			delete Wheel::mTicks;
+			Wheel::mTicks = nullptr;
+			delete Jobs::mQueue;
+			Jobs::mQueue = nullptr;
+		}
+
+		Timeout::Timeout() : mDuration(0), mSlack(0), mTimeoutId(0), mTick(0), mFile(""), mLine(0) {}
+
+		Timeout::~Timeout()
+		{
+			stop();
+		}
+
+		void Timeout::setup(uint ms, std::function<bool()> function, const char* file, int line)
+		{
+			setup(ms, std::min(ms / 8, Wheel::MAX_SLACK), function, file, line);
+		}
+
+		void Timeout::setup(uint ms, uint slack, std::function<bool()> function, const char* file, int line)
 		{
 			mDuration = ms;
+			mSlack = slack;
 			mFunction = function;
+			mFile = file;
+			mLine = line;
 		}
 
 		void Timeout::start()
 		{
 			stop();
-			mTimeoutId = g_timeout_add(mDuration, G_SOURCE_FUNC(+[](Timeout* me) {
-				bool cont = me->mFunction();
 
-				if (!cont)
-					me->mTimeoutId = 0;
-				return cont;
-			}),
-				this);
+			if (++Wheel::mLastId == 0)
+				++Wheel::mLastId;
+
+			mTimeoutId = Wheel::mLastId;
+			Wheel::insert(this);
 		}
 
 		void Timeout::stop()
 		{
 			if (mTimeoutId)
 			{
-				g_source_remove(mTimeoutId);
+				Wheel::remove(this);
 				mTimeoutId = 0;
 			}
 		}
 
-		Idle::Idle() : mIdleId(0) {}
+		Idle::Idle() : mPriority(JOB_NORMAL), mIdleId(0), mFile(""), mLine(0) {}
 
-		void Idle::setup(std::function<bool()> function)
+		Idle::~Idle()
+		{
+			stop();
+		}
+
+		void Idle::setup(std::function<bool()> function, JobPriority priority, const char* file, int line)
 		{
 			mFunction = function;
+			mPriority = priority;
+			mFile = file;
+			mLine = line;
 		}
 
 		void Idle::start()
 		{
 			stop();
-			mIdleId = g_idle_add(G_SOURCE_FUNC(+[](Idle* me) {
-				bool cont = me->mFunction();
-				if (!cont)
-					me->mIdleId = 0;
+
+			if (++Jobs::mLastIdleId == 0)
+				++Jobs::mLastIdleId;
+
+			uint id = mIdleId = Jobs::mLastIdleId;
+			queueJob(this, mPriority, [this, id]() {
+				bool cont = mFunction();
+
+				if (!cont && mIdleId == id)
+					mIdleId = 0;
 				return cont;
-			}),
-				this);
+			},
+				mFile, mLine);
 		}
 
 		void Idle::stop()
 		{
 			if (mIdleId != 0)
 			{
-				g_source_remove(mIdleId);
+				cancelJob(this);
 				mIdleId = 0;
 			}
 		}
@@ -53,33 +53,77 @@ namespace Help
 		void cssClassAdd(GtkWidget* widget, const char* className);
 		void cssClassRemove(GtkWidget* widget, const char* className);
 
+		// Timeouts don't own a GLib source each: they are sorted into the ticks of one shared
+		// timer wheel, and may fire up to `slack` ms late so that their wakeups line up.
+		// Without an explicit slack, an eighth of the duration is allowed, capped to 50 ms.
+		// Their callbacks are audited under the place they were set up from.
 		class Timeout
 		{
 		public:
 			Timeout();
+			~Timeout();
 
-			void setup(uint ms, std::function<bool()> function);
+			void setup(uint ms, std::function<bool()> function,
+				const char* file = __builtin_FILE(), int line = __builtin_LINE());
+			void setup(uint ms, uint slack, std::function<bool()> function,
+				const char* file = __builtin_FILE(), int line = __builtin_LINE());
 
 			void start();
 			void stop();
 
 			uint mDuration;
+			uint mSlack;
 			std::function<bool()> mFunction;
 
 			uint mTimeoutId;
+			gint64 mTick;
+
+			const char* mFile;
+			int mLine;
 		};
 
+		// Logs the timer wheel and job queue stats and drops their wakeup sources
+		void finalize();
+
+		// Main loop wakeups caused by timeouts and jobs so far
+		uint getWakeups();
+
+		enum JobPriority
+		{
+			JOB_HIGH,
+			JOB_NORMAL,
+			JOB_LOW
+		};
+
+		// Main loop work queue: jobs run in slices, highest priority first, until each main loop
+		// iteration's time budget is spent. A job is called again as long as it returns true.
+		// Queueing a key that is queued already replaces its function but keeps its place.
+		void queueJob(const void* key, JobPriority priority, std::function<bool()> slice,
+			const char* file = __builtin_FILE(), int line = __builtin_LINE());
+		void cancelJob(const void* key);
+		bool isJobQueued(const void* key);
+		uint getJobQueueDepth();
+		// Job slices that ran past the main loop iteration's budget so far
+		uint getJobOverruns();
+
+		// A job of the work queue, keyed by the Idle itself
 		class Idle
 		{
 		public:
 			Idle();
+			~Idle();
 
-			void setup(std::function<bool()> function);
+			void setup(std::function<bool()> function, JobPriority priority = JOB_NORMAL,
+				const char* file = __builtin_FILE(), int line = __builtin_LINE());
 			void start();
 			void stop();
 
 			std::function<bool()> mFunction;
+			JobPriority mPriority;
 			uint mIdleId;
+
+			const char* mFile;
+			int mLine;
 		};
 	} // namespace Gtk
 } // namespace Help
@@ -0,0 +1,297 @@
+/*
+ * Copyright (c) 2019-2020 Nicolas Szabo <nszabo@vivaldi.net>
+ * Copyright (c) 2020-2021 David Keogh <davidtkeogh@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "IconCache.hpp"
+#include "Dock.hpp"
+
+#include <glib/gstdio.h>
+#include <utime.h>
+
+#include <cstring>
+
+namespace IconCache
+{
+	// Cache files are this header followed by the surface data. The header size
+	// keeps the pixel data 16-byte aligned inside the mapping.
+	struct Header
+	{
+		char magic[8];
+		guint32 width;
+		guint32 height;
+		guint32 stride;
+		guint32 format;
+		guint32 reserved[2];
+	};
+
+	const char mMagic[8] = {'D', 'L', 'I', 'C', 'O', 'N', '1', '\0'};
+
+	// files unused for this long are swept at startup, hits refresh a file's mtime once a day
+	const gint64 mMaxAge = 30 * 24 * 3600;
+	const gint64 mTouchAge = 24 * 3600;
+
+	std::string mCacheDir;
+	gulong mThemeChangedId = 0;
+	cairo_user_data_key_t mMappedFileKey;
+
+	uint mHits = 0;
+	uint mMisses = 0;
+	uint mEvicted = 0;
+	gint64 mLookupTime = 0;
+
+	static std::string cachePath(const std::string& icon, const std::string& source, gint64 mtime, int size, int scale)
+	{
+		gchar* key = g_strdup_printf("%s\n%s\n%" G_GINT64_FORMAT "\n%d\n%d", icon.c_str(), source.c_str(), mtime, size, scale);
+		gchar* checksum = g_compute_checksum_for_string(G_CHECKSUM_SHA1, key, -1);
+		gchar* basename = g_strconcat(checksum, ".argb", nullptr);
+		gchar* path = g_build_filename(mCacheDir.c_str(), basename, nullptr);
+		std::string ret = path;
+
+		g_free(path);
+		g_free(basename);
+		g_free(checksum);
+		g_free(key);
+
+		return ret;
+	}
+
+	static cairo_surface_t* load(const std::string& path, int scale)
+	{
+		GMappedFile* file = g_mapped_file_new(path.c_str(), false, nullptr);
+		if (file == nullptr)
+			return nullptr;
+
+		gsize length = g_mapped_file_get_length(file);
+		gchar* contents = g_mapped_file_get_contents(file);
+		Header header;
+
+		if (length < sizeof(Header))
+		{
+			g_mapped_file_unref(file);
+			return nullptr;
+		}
+
+		memcpy(&header, contents, sizeof(Header));
+
+		if (memcmp(header.magic, mMagic, sizeof(mMagic)) != 0
+			|| (header.format != CAIRO_FORMAT_ARGB32 && header.format != CAIRO_FORMAT_RGB24)
+			|| header.width == 0 || header.height == 0
+			|| (int)header.stride != cairo_format_stride_for_width((cairo_format_t)header.format, header.width)
+			|| length < sizeof(Header) + (gsize)header.stride * header.height)
+		{
+			g_mapped_file_unref(file);
+			return nullptr;
+		}
+
+		// The mapping is read-only: the surface must only ever be used as a source.
+		cairo_surface_t* surface = cairo_image_surface_create_for_data((unsigned char*)contents + sizeof(Header),
+			(cairo_format_t)header.format, header.width, header.height, header.stride);
+
+		if (cairo_surface_status(surface) != CAIRO_STATUS_SUCCESS)
+		{
+			cairo_surface_destroy(surface);
+			g_mapped_file_unref(file);
+			return nullptr;
+		}
+
+		cairo_surface_set_user_data(surface, &mMappedFileKey, file, (cairo_destroy_func_t)g_mapped_file_unref);
+		cairo_surface_set_device_scale(surface, scale, scale);
+
+		// keeps files in use from being swept
+		GStatBuf sb;
+		gint64 now = g_get_real_time() / G_USEC_PER_SEC;
+		if (g_stat(path.c_str(), &sb) == 0 && now - sb.st_mtime > mTouchAge)
+		{
+			struct utimbuf times = {(time_t)now, (time_t)now};
+			g_utime(path.c_str(), &times);
+		}
+
+		return surface;
+	}
+
+	static void save(const std::string& path, cairo_surface_t* surface)
+	{
+		if (cairo_surface_get_type(surface) != CAIRO_SURFACE_TYPE_IMAGE)
+			return;
+
+		cairo_surface_flush(surface);
+
+		Header header = {};
+		memcpy(header.magic, mMagic, sizeof(mMagic));
+		header.width = cairo_image_surface_get_width(surface);
+		header.height = cairo_image_surface_get_height(surface);
+		header.stride = cairo_image_surface_get_stride(surface);
+		header.format = cairo_image_surface_get_format(surface);
+
+		if (header.format != CAIRO_FORMAT_ARGB32 && header.format != CAIRO_FORMAT_RGB24)
+			return;
+
+		std::string contents((const char*)&header, sizeof(Header));
+		contents.append((const char*)cairo_image_surface_get_data(surface), (size_t)header.stride * header.height);
+
+		GError* error = nullptr;
+		if (!g_file_set_contents(path.c_str(), contents.data(), contents.size(), &error))
+		{
+			g_warning("Failed to write icon cache file '%s': %s", path.c_str(), error->message);
+			g_error_free(error);
+		}
+	}
+
+	static cairo_surface_t* render(const std::string& icon, GtkIconInfo* iconInfo, int size, int scale)
+	{
+		GdkPixbuf* pixbuf;
+
+		if (iconInfo != nullptr && gtk_icon_info_is_symbolic(iconInfo))
+			pixbuf = gtk_icon_info_load_symbolic_for_context(iconInfo,
+				gtk_widget_get_style_context(Dock::mBox), nullptr, nullptr);
+		else if (iconInfo != nullptr)
+			pixbuf = gtk_icon_info_load_icon(iconInfo, nullptr);
+		else
+			pixbuf = gdk_pixbuf_new_from_file_at_scale(icon.c_str(), size * scale, size * scale, false, nullptr);
+
+		if (pixbuf == nullptr)
+			return nullptr;
+
+		cairo_surface_t* surface = gdk_cairo_surface_create_from_pixbuf(pixbuf, scale, nullptr);
+		g_object_unref(pixbuf);
+
+		return surface;
+	}
+
+	static void sweep()
+	{
+		GDir* dir = g_dir_open(mCacheDir.c_str(), 0, nullptr);
+		if (dir == nullptr)
+			return;
+
+		gint64 now = g_get_real_time() / G_USEC_PER_SEC;
+		const gchar* name;
+
+		while ((name = g_dir_read_name(dir)) != nullptr)
+		{
+			if (!g_str_has_suffix(name, ".argb"))
+				continue;
+
+			gchar* path = g_build_filename(mCacheDir.c_str(), name, nullptr);
+			GStatBuf sb;
+
+			if (g_stat(path, &sb) == 0 && now - sb.st_mtime > mMaxAge && g_unlink(path) == 0)
+				++mEvicted;
+
+			g_free(path);
+		}
+
+		g_dir_close(dir);
+	}
+
+	void init()
+	{
+		gchar* dir = g_build_filename(g_get_user_cache_dir(), "xfce4-docklike-plugin", "icons", nullptr);
+
+		if (g_mkdir_with_parents(dir, 0700) == 0)
+			mCacheDir = dir;
+		else
+			g_warning("Unable to create icon cache directory '%s'", dir);
+
+		g_free(dir);
+
+		// files of old themes, icon versions, panel sizes and scales
+		if (!mCacheDir.empty())
+			Help::Gtk::queueJob(&mCacheDir, Help::Gtk::JOB_LOW, []() {
+				sweep();
+				return false;
+			});
+
+		// Dock icons are set as surfaces, so they don't follow icon theme changes by themselves
+		mThemeChangedId = g_signal_connect(G_OBJECT(gtk_icon_theme_get_default()), "changed",
+			G_CALLBACK(+[](GtkIconTheme* iconTheme) {
+				Dock::onPanelResize();
+			}),
+			nullptr);
+	}
+
+	void finalize()
+	{
+		g_debug("Icon cache: %u hits, %u misses, %" G_GINT64_FORMAT " us spent in lookups, %u old files evicted",
+			mHits, mMisses, mLookupTime, mEvicted);
+
+		Help::Gtk::cancelJob(&mCacheDir);
+
+		if (mThemeChangedId != 0)
+			g_signal_handler_disconnect(G_OBJECT(gtk_icon_theme_get_default()), mThemeChangedId);
+
+		mThemeChangedId = 0;
+		mCacheDir.clear();
+		mHits = mMisses = mEvicted = 0;
+		mLookupTime = 0;
+	}
+
+	cairo_surface_t* lookup(const std::string& icon, int size, int scale)
+	{
+		if (icon.empty() || size <= 0)
+			return nullptr;
+
+		gint64 start = g_get_monotonic_time();
+		GtkIconInfo* iconInfo = nullptr;
+		std::string source;
+
+		if (icon[0] == '/')
+			source = icon;
+		else
+		{
+			iconInfo = gtk_icon_theme_lookup_icon_for_scale(gtk_icon_theme_get_default(),
+				icon.c_str(), size, scale, GTK_ICON_LOOKUP_FORCE_SIZE);
+
+			if (iconInfo == nullptr)
+				return nullptr;
+
+			// builtin and resource icons have no file to check against
+			// symbolic icons are recolored for the panel style, they are not cached
+			const gchar* filename = gtk_icon_info_get_filename(iconInfo);
+			if (filename != nullptr && !gtk_icon_info_is_symbolic(iconInfo))
+				source = filename;
+		}
+
+		GStatBuf sb;
+		std::string path;
+		cairo_surface_t* surface = nullptr;
+
+		if (!mCacheDir.empty() && !source.empty() && g_stat(source.c_str(), &sb) == 0)
+		{
+			path = cachePath(icon, source, sb.st_mtime, size, scale);
+			surface = load(path, scale);
+		}
+
+		if (surface != nullptr)
+			++mHits;
+		else
+		{
+			++mMisses;
+			surface = render(icon, iconInfo, size, scale);
+
+			if (surface != nullptr && !path.empty())
+				save(path, surface);
+		}
+
+		if (iconInfo != nullptr)
+			g_object_unref(iconInfo);
+
+		mLookupTime += g_get_monotonic_time() - start;
+
+		return surface;
+	}
+} // namespace IconCache
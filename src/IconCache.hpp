@@ -0,0 +1,38 @@
+/*
+ * Copyright (c) 2019-2020 Nicolas Szabo <nszabo@vivaldi.net>
+ * Copyright (c) 2020-2021 David Keogh <davidtkeogh@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef ICON_CACHE_HPP
+#define ICON_CACHE_HPP
+
+#include <gtk/gtk.h>
+
+#include <string>
+
+// Per-user on-disk cache of rasterized dock icons, stored as premultiplied ARGB
+// and memory-mapped back into cairo image surfaces on the next start.
+namespace IconCache
+{
+	void init();
+	void finalize();
+
+	// Returns a new surface of `size` logical pixels for an icon name or an absolute path,
+	// or nullptr if the icon can't be found.
+	cairo_surface_t* lookup(const std::string& icon, int size, int scale);
+} // namespace IconCache
+
+#endif // ICON_CACHE_HPP
@@ -16,6 +16,7 @@
  */
 
 #include "LauncherEntry.hpp"
+#include "Audit.hpp"
 #include "Dock.hpp"
 #include "Group.hpp"
 #include "Settings.hpp"
@@ -107,6 +108,7 @@ struct LauncherEntry::Impl
 	static void onLauncherUpdate(GDBusConnection*, const gchar* senderName, const gchar*,
 		const gchar*, const gchar*, GVariant* parameters, gpointer userData)
 	{
+		Audit::Scope audit(Audit::KIND_DBUS, "unity launcher Update");
 		Impl* impl = static_cast<Impl*>(userData);
 		if (senderName == nullptr || parameters == nullptr || !g_variant_is_of_type(parameters, G_VARIANT_TYPE("(sa{sv})")))
 			return;
@@ -139,6 +141,7 @@ struct LauncherEntry::Impl
 	static void onNameOwnerChanged(GDBusConnection*, const gchar*, const gchar*,
 		const gchar*, const gchar*, GVariant* parameters, gpointer userData)
 	{
+		Audit::Scope audit(Audit::KIND_DBUS, "dbus NameOwnerChanged");
 		Impl* impl = static_cast<Impl*>(userData);
 		const gchar* name;
 		const gchar* previousOwner;
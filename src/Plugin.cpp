@@ -19,10 +19,21 @@
 #ifdef HAVE_XFCE_REVISION_H
 #include "xfce-revision.h"
 #endif
+#include "Audit.hpp"
 #include "Helpers.hpp"
 #include "Hotkeys.hpp"
+#include "IconCache.hpp"
 #include "LauncherEntry.hpp"
 #include "Plugin.hpp"
+#include "PopupWindow.hpp"
+#include "PowerSaver.hpp"
+#include "PreviewCache.hpp"
+#include "PreviewPipeline.hpp"
+#include "PreviewPrefetch.hpp"
+#include "PreviewScheduler.hpp"
+#include "Trace.hpp"
+#include "WindowCapture.hpp"
+#include "WindowIcons.hpp"
 
 namespace Plugin
 {
@@ -39,6 +50,12 @@ namespace Plugin
 		mPointer = gdk_seat_get_pointer(gdk_display_get_default_seat(mDisplay));
 
 		Settings::init();
+		IconCache::init();
+		WindowCapture::init();
+		PreviewPipeline::init();
+		PreviewScheduler::init();
+		PreviewPrefetch::init();
+		PowerSaver::init();
 		AppInfos::init();
 		Xfw::init();
 		Dock::init();
@@ -77,6 +94,27 @@ namespace Plugin
 			}),
 			nullptr);
 
+		// one motion watcher for the whole dock, the buttons don't select motion events
+		gtk_widget_add_events(GTK_WIDGET(mXfPlugin), GDK_POINTER_MOTION_MASK);
+		g_signal_connect(G_OBJECT(mXfPlugin), "motion-notify-event",
+			G_CALLBACK(+[](GtkWidget* widget, GdkEventMotion* event) {
+				Audit::Scope audit(Audit::KIND_SIGNAL, "dock motion-notify");
+				PopupWindow::pointerMoved(event->x_root, event->y_root);
+				PreviewPrefetch::pointerMoved(event->x_root, event->y_root);
+				return false;
+			}),
+			nullptr);
+
+		// entering is reported by motion events already, leaving starts the pointer sampling
+		gtk_widget_add_events(GTK_WIDGET(mXfPlugin), GDK_LEAVE_NOTIFY_MASK);
+		g_signal_connect(G_OBJECT(mXfPlugin), "leave-notify-event",
+			G_CALLBACK(+[](GtkWidget* widget, GdkEventCrossing* event) {
+				Audit::Scope audit(Audit::KIND_SIGNAL, "dock leave-notify");
+				PreviewPrefetch::pointerLeft(event->x_root, event->y_root);
+				return false;
+			}),
+			nullptr);
+
 		g_signal_connect(G_OBJECT(mXfPlugin), "remote-event",
 			G_CALLBACK(+[](XfcePanelPlugin* plugin, gchar* name, GValue* value) {
 				remoteEvent(name, value);
@@ -88,11 +126,27 @@ namespace Plugin
 		g_signal_connect(G_OBJECT(mXfPlugin), "free-data",
 			G_CALLBACK(+[](XfcePanelPlugin* plugin) {
 				LauncherEntry::finalize();
+				PowerSaver::finalize();
+				PreviewPrefetch::finalize();
+				PreviewScheduler::finalize();
+				PreviewPipeline::finalize();
 				Xfw::finalize();
 				Dock::mGroups.clear();
+				GroupMenuItem::finalize();
+				PopupWindow::finalize();
+				WindowIcons::finalize();
+				PreviewCache::finalize();
+				Theme::finalize();
 				AppInfos::finalize();
+				IconCache::finalize();
+				WindowCapture::finalize();
 				Hotkeys::finalize();
 				Settings::finalize();
+				Help::Gtk::finalize();
+				Audit::finalize();
+#ifdef ENABLE_TRACE
+				Trace::finalize();
+#endif
 			}),
 			nullptr);
 
@@ -131,6 +185,20 @@ namespace Plugin
 			aboutDialog();
 		else if (g_strcmp0(name, "switch-to-last-window") == 0 && Settings::keyAloneActive)
 			Xfw::switchToLastWindow();
+		else if (g_strcmp0(name, "dump-stats") == 0)
+			Audit::dump(G_VALUE_HOLDS_STRING(value) && g_value_get_string(value) != nullptr ? g_value_get_string(value) : "");
+		else if (g_strcmp0(name, "bench-popup") == 0)
+			Dock::benchPopup();
+		else if (g_strcmp0(name, "bench-buttons") == 0)
+			Dock::benchButtons();
+#ifdef ENABLE_TRACE
+		else if (g_strcmp0(name, "trace-start") == 0)
+			Trace::setRecording(true);
+		else if (g_strcmp0(name, "trace-stop") == 0)
+			Trace::setRecording(false);
+		else if (g_strcmp0(name, "trace-dump") == 0)
+			Trace::dump(G_VALUE_HOLDS_STRING(value) && g_value_get_string(value) != nullptr ? g_value_get_string(value) : "");
+#endif
 		else if (g_strcmp0(name, "activate-group") == 0)
 		{
 			if (G_VALUE_HOLDS_INT64(value) && Settings::keyComboActive)
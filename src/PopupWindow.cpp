@@ -0,0 +1,197 @@
+/*
+ * Copyright (c) 2019-2020 Nicolas Szabo <nszabo@vivaldi.net>
+ * Copyright (c) 2020-2021 David Keogh <davidtkeogh@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifdef ENABLE_WAYLAND
+#include <gtk-layer-shell.h>
+#endif
+
+#include "PopupWindow.hpp"
+#include "Group.hpp"
+#include "GroupMenu.hpp"
+#include "Plugin.hpp"
+
+namespace PopupWindow
+{
+	GtkWidget* mWindow = nullptr;
+	GroupMenu* mOwner = nullptr;
+	gulong mScaleFactorId = 0;
+
+	static GtkWidget* create()
+	{
+		GtkWidget* window = gtk_window_new(GTK_WINDOW_POPUP);
+		gtk_widget_add_events(window, GDK_SCROLL_MASK | GDK_POINTER_MOTION_MASK);
+		gtk_window_set_default_size(GTK_WINDOW(window), 1, 1);
+		Help::Gtk::cssClassAdd(window, "xfce-docklike-window");
+
+		gtk_widget_set_app_paintable(window, true);
+		GdkScreen* screen = gtk_widget_get_screen(window);
+		GdkVisual* visual = gdk_screen_get_rgba_visual(screen);
+		if (visual != nullptr)
+		{
+			gtk_widget_set_visual(window, visual);
+		}
+
+#ifdef ENABLE_WAYLAND
+		if (gtk_layer_is_supported())
+		{
+			gtk_layer_init_for_window(GTK_WINDOW(window));
+			gtk_layer_set_exclusive_zone(GTK_WINDOW(window), -1);
+			gtk_layer_set_anchor(GTK_WINDOW(window), GTK_LAYER_SHELL_EDGE_TOP, true);
+			gtk_layer_set_anchor(GTK_WINDOW(window), GTK_LAYER_SHELL_EDGE_LEFT, true);
+		}
+#endif
+
+		//--------------------------------------------------
+
+		g_signal_connect(G_OBJECT(window), "enter-notify-event",
+			G_CALLBACK(+[](GtkWidget* widget, GdkEvent* event) {
+				if (mOwner != nullptr)
+					mOwner->mMouseHover = true;
+				return true;
+			}),
+			nullptr);
+
+		g_signal_connect(G_OBJECT(window), "leave-notify-event",
+			G_CALLBACK(+[](GtkWidget* widget, GdkEventCrossing* event) {
+				if (event->detail == GDK_NOTIFY_INFERIOR)
+				{
+					return false;
+				}
+				if (mOwner != nullptr)
+				{
+					mOwner->mGroup->setMouseLeaveTimeout(event->x_root, event->y_root);
+					mOwner->mMouseHover = false;
+				}
+
+				return true;
+			}),
+			nullptr);
+
+		g_signal_connect(G_OBJECT(window), "motion-notify-event",
+			G_CALLBACK(+[](GtkWidget* widget, GdkEventMotion* event) {
+				pointerMoved(event->x_root, event->y_root);
+				return false;
+			}),
+			nullptr);
+
+		g_signal_connect(G_OBJECT(window), "configure-event",
+			G_CALLBACK(+[](GtkWidget* widget, GdkEventConfigure* event) {
+				if (mOwner != nullptr)
+					mOwner->mRect = {event->x, event->y, event->width, event->height};
+				return false;
+			}),
+			nullptr);
+
+		g_signal_connect(G_OBJECT(window), "scroll-event",
+			G_CALLBACK(+[](GtkWidget* widget, GdkEventScroll* event) {
+				if (mOwner != nullptr)
+					mOwner->mGroup->scrollWindows(event->time, event->direction);
+				return true;
+			}),
+			nullptr);
+
+		return window;
+	}
+
+	void finalize()
+	{
+		if (mScaleFactorId != 0)
+			g_signal_handler_disconnect(G_OBJECT(Plugin::mXfPlugin), mScaleFactorId);
+		mScaleFactorId = 0;
+
+		if (mWindow != nullptr)
+			gtk_widget_destroy(mWindow);
+		mWindow = nullptr;
+		mOwner = nullptr;
+	}
+
+	GtkWindow* get()
+	{
+		if (mWindow != nullptr)
+			return GTK_WINDOW(mWindow);
+
+		mWindow = create();
+
+		// the rgba visual and the layer shell surface are tied to the window, which is made again
+		mScaleFactorId = g_signal_connect(G_OBJECT(Plugin::mXfPlugin), "notify::scale-factor",
+			G_CALLBACK(+[](GtkWidget* widget, GParamSpec* pspec) {
+				GtkWidget* child = gtk_bin_get_child(GTK_BIN(mWindow));
+
+				if (child != nullptr)
+					gtk_container_remove(GTK_CONTAINER(mWindow), child);
+
+				gtk_widget_destroy(mWindow);
+				mWindow = create();
+
+				if (child != nullptr)
+					gtk_container_add(GTK_CONTAINER(mWindow), child);
+				if (mOwner != nullptr)
+					mOwner->mItemExtent = 0;
+			}),
+			nullptr);
+
+		return GTK_WINDOW(mWindow);
+	}
+
+	bool isOwner(const GroupMenu* menu)
+	{
+		return mOwner == menu && menu != nullptr;
+	}
+
+	void attach(GroupMenu* menu)
+	{
+		GtkWindow* window = get();
+
+		if (mOwner == menu)
+			return;
+
+		// the contents stay in the window while it is hidden, as the same menu often comes back
+		if (mOwner != nullptr)
+		{
+			if (mOwner->mVisible)
+				mOwner->hide();
+			gtk_container_remove(GTK_CONTAINER(window), mOwner->mScrolledWindow);
+		}
+
+		mOwner = menu;
+		gtk_container_add(GTK_CONTAINER(window), menu->mScrolledWindow);
+		gtk_window_resize(window, 1, 1);
+	}
+
+	void hide(GroupMenu* menu)
+	{
+		if (isOwner(menu))
+			gtk_widget_hide(mWindow);
+	}
+
+	void pointerMoved(int x, int y)
+	{
+		if (mOwner != nullptr)
+			mOwner->mGroup->onPointerMotion(x, y);
+	}
+
+	void forget(GroupMenu* menu)
+	{
+		if (!isOwner(menu))
+			return;
+
+		gtk_widget_hide(mWindow);
+		gtk_container_remove(GTK_CONTAINER(mWindow), menu->mScrolledWindow);
+		mOwner = nullptr;
+	}
+} // namespace PopupWindow
@@ -0,0 +1,44 @@
+/*
+ * Copyright (c) 2019-2020 Nicolas Szabo <nszabo@vivaldi.net>
+ * Copyright (c) 2020-2021 David Keogh <davidtkeogh@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef POPUP_WINDOW_HPP
+#define POPUP_WINDOW_HPP
+
+#include <gtk/gtk.h>
+
+class GroupMenu;
+
+// The one popup window shared by all group menus. It is created the first time a menu is
+// shown, and holds the contents of the last menu shown until another one takes it over.
+namespace PopupWindow
+{
+	void finalize();
+
+	GtkWindow* get();
+	bool isOwner(const GroupMenu* menu);
+
+	// Puts the menu's contents in the popup, hiding the menu that had it
+	void attach(GroupMenu* menu);
+	void hide(GroupMenu* menu);
+	void forget(GroupMenu* menu);
+
+	// Pointer motion seen over the dock or the popup, in root coordinates
+	void pointerMoved(int x, int y);
+} // namespace PopupWindow
+
+#endif // POPUP_WINDOW_HPP
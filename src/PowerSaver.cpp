@@ -0,0 +1,332 @@
+/*
+ * Copyright (c) 2019-2020 Nicolas Szabo <nszabo@vivaldi.net>
+ * Copyright (c) 2020-2021 David Keogh <davidtkeogh@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "PowerSaver.hpp"
+#include "Audit.hpp"
+#include "Dock.hpp"
+#include "Group.hpp"
+#include "Plugin.hpp"
+#include "PreviewPrefetch.hpp"
+#include "PreviewScheduler.hpp"
+
+#include <gio/gio.h>
+
+#include <vector>
+
+namespace PowerSaver
+{
+	// both are emitted by xfce4-screensaver, other screensavers implement either one
+	const char* const mScreenSaverInterfaces[] = {"org.freedesktop.ScreenSaver", "org.xfce.ScreenSaver"};
+
+	GDBusConnection* mConnection = nullptr;
+	GCancellable* mCancellable = nullptr;
+	std::vector<guint> mSignalIds;
+	std::vector<gulong> mHandlerIds;
+	GtkWidget* mToplevel = nullptr;
+	std::vector<gulong> mToplevelHandlerIds;
+	// after the pointer leaves the dock, once the panel had time to autohide
+	Help::Gtk::Timeout mRecheck;
+	const uint mRecheckDelay = 1500;
+
+	bool mPanelVisible = false;
+	bool mObscured = false;
+	bool mScreenSaverActive = false;
+	bool mSuspended = false;
+
+	// 0 while not suspended, or while the plugin is not shown yet
+	gint64 mSuspendStart = 0;
+	uint mSuspendStartWakeups = 0;
+	uint mSuspends = 0;
+	gint64 mSuspendedTime = 0;
+	uint mSuspendedWakeups = 0;
+
+	static void resume()
+	{
+		PreviewPrefetch::powerChanged();
+
+		// badges that changed were not drawn, and open popups had their refreshes stopped
+		Dock::mGroups.forEach([](std::pair<std::shared_ptr<AppInfo>, std::shared_ptr<Group>> g) -> void {
+			Group* group = g.second.get();
+
+			if (group->mLauncherRedrawPending)
+			{
+				group->mLauncherRedrawPending = false;
+				gtk_widget_queue_draw(group->mButton);
+			}
+
+			if (group->mGroupMenu.mVisible)
+				group->mGroupMenu.schedulePreviews();
+		});
+	}
+
+	static void update()
+	{
+		bool suspended = !mPanelVisible || mScreenSaverActive;
+
+		if (suspended == mSuspended)
+			return;
+
+		mSuspended = suspended;
+		gint64 now = g_get_monotonic_time();
+
+		if (suspended)
+		{
+			++mSuspends;
+			mSuspendStart = now;
+			mSuspendStartWakeups = Help::Gtk::getWakeups();
+
+			PreviewScheduler::stop();
+			PreviewPrefetch::powerChanged();
+		}
+		else
+		{
+			if (mSuspendStart != 0)
+			{
+				mSuspendedTime += now - mSuspendStart;
+				mSuspendedWakeups += Help::Gtk::getWakeups() - mSuspendStartWakeups;
+				mSuspendStart = 0;
+			}
+
+			resume();
+		}
+	}
+
+	// An autohidden xfce4-panel keeps its plugins mapped, it moves its window off the
+	// monitor or slides it out. So the plugin counts as shown while at least a quarter of
+	// its thickness is on the monitor and the X server doesn't report it fully obscured.
+	static void checkPanel()
+	{
+		GtkWidget* plugin = GTK_WIDGET(Plugin::mXfPlugin);
+		GtkWidget* toplevel = gtk_widget_get_toplevel(plugin);
+		GdkWindow* window = gtk_widget_get_window(toplevel);
+
+		if (!gtk_widget_get_mapped(plugin) || window == nullptr || mObscured)
+		{
+			mPanelVisible = false;
+			update();
+			return;
+		}
+
+		gint x, y, ox, oy;
+		GtkAllocation allocation;
+		gtk_widget_get_allocation(plugin, &allocation);
+		gtk_widget_translate_coordinates(plugin, toplevel, 0, 0, &x, &y);
+		gdk_window_get_origin(window, &ox, &oy);
+
+		GdkRectangle area = {ox + x, oy + y, allocation.width, allocation.height};
+		GdkRectangle monitor, shown;
+		gdk_monitor_get_geometry(gdk_display_get_monitor_at_window(gdk_window_get_display(window), window), &monitor);
+
+		if (!gdk_rectangle_intersect(&area, &monitor, &shown))
+			mPanelVisible = false;
+		else if (xfce_panel_plugin_get_mode(Plugin::mXfPlugin) == XFCE_PANEL_PLUGIN_MODE_HORIZONTAL)
+			mPanelVisible = shown.height * 4 >= area.height;
+		else
+			mPanelVisible = shown.width * 4 >= area.width;
+
+		update();
+	}
+
+	static void disconnectToplevel()
+	{
+		for (gulong id : mToplevelHandlerIds)
+			g_signal_handler_disconnect(G_OBJECT(mToplevel), id);
+
+		mToplevelHandlerIds.clear();
+		mToplevel = nullptr;
+	}
+
+	// The panel window of an internal plugin, the wrapper's plug of an external one
+	static void watchToplevel()
+	{
+		GtkWidget* toplevel = gtk_widget_get_toplevel(GTK_WIDGET(Plugin::mXfPlugin));
+
+		if (toplevel == mToplevel || !gtk_widget_is_toplevel(toplevel))
+			return;
+
+		disconnectToplevel();
+		mToplevel = toplevel;
+		gtk_widget_add_events(toplevel, GDK_STRUCTURE_MASK | GDK_VISIBILITY_NOTIFY_MASK);
+
+		mToplevelHandlerIds.push_back(g_signal_connect(G_OBJECT(toplevel), "configure-event",
+			G_CALLBACK(+[](GtkWidget* widget, GdkEventConfigure* event) {
+				checkPanel();
+				return false;
+			}),
+			nullptr));
+
+		// not sent for a composited panel, the geometry checks cover that
+		mToplevelHandlerIds.push_back(g_signal_connect(G_OBJECT(toplevel), "visibility-notify-event",
+			G_CALLBACK(+[](GtkWidget* widget, GdkEventVisibility* event) {
+				mObscured = event->state == GDK_VISIBILITY_FULLY_OBSCURED;
+				checkPanel();
+				return false;
+			}),
+			nullptr));
+	}
+
+	static void setScreenSaverActive(GVariant* parameters)
+	{
+		if (!g_variant_is_of_type(parameters, G_VARIANT_TYPE("(b)")))
+			return;
+
+		gboolean active;
+		g_variant_get(parameters, "(b)", &active);
+		mScreenSaverActive = active;
+		update();
+	}
+
+	void init()
+	{
+		GtkWidget* plugin = GTK_WIDGET(Plugin::mXfPlugin);
+
+		// a hidden panel or a plugin moved to another panel is unmapped
+		mHandlerIds.push_back(g_signal_connect(G_OBJECT(plugin), "map",
+			G_CALLBACK(+[](GtkWidget* widget) {
+				watchToplevel();
+				checkPanel();
+			}),
+			nullptr));
+
+		mHandlerIds.push_back(g_signal_connect(G_OBJECT(plugin), "unmap",
+			G_CALLBACK(+[](GtkWidget* widget) {
+				mRecheck.stop();
+				mPanelVisible = false;
+				update();
+			}),
+			nullptr));
+
+		// An external plugin's plug gets no configure events when the panel window moves,
+		// and a composited panel no visibility events. The panel autohides only once the
+		// pointer left it, and shows again under the pointer.
+		gtk_widget_add_events(plugin, GDK_ENTER_NOTIFY_MASK | GDK_LEAVE_NOTIFY_MASK);
+		mHandlerIds.push_back(g_signal_connect(G_OBJECT(plugin), "leave-notify-event",
+			G_CALLBACK(+[](GtkWidget* widget, GdkEventCrossing* event) {
+				if (event->detail != GDK_NOTIFY_INFERIOR)
+					mRecheck.start();
+				return false;
+			}),
+			nullptr));
+
+		mHandlerIds.push_back(g_signal_connect(G_OBJECT(plugin), "enter-notify-event",
+			G_CALLBACK(+[](GtkWidget* widget, GdkEventCrossing* event) {
+				mRecheck.stop();
+				if (mSuspended)
+					checkPanel();
+				return false;
+			}),
+			nullptr));
+
+		mRecheck.setup(mRecheckDelay, []() {
+			checkPanel();
+			return false;
+		});
+
+		// The plugin is not mapped yet when it starts. That holds the work back like a
+		// suspend, but is not counted as one, and the first map resumes it.
+		mPanelVisible = gtk_widget_get_mapped(plugin);
+		mSuspended = !mPanelVisible;
+
+		if (mSuspended)
+		{
+			PreviewScheduler::stop();
+			PreviewPrefetch::powerChanged();
+		}
+
+		GError* error = nullptr;
+		mConnection = g_bus_get_sync(G_BUS_TYPE_SESSION, nullptr, &error);
+		if (mConnection == nullptr)
+		{
+			g_warning("Unable to watch the screensaver: %s", error->message);
+			g_clear_error(&error);
+			return;
+		}
+
+		for (const char* interface : mScreenSaverInterfaces)
+			mSignalIds.push_back(g_dbus_connection_signal_subscribe(mConnection,
+				nullptr, interface, "ActiveChanged", nullptr, nullptr, G_DBUS_SIGNAL_FLAGS_NONE,
+				[](GDBusConnection* connection, const gchar* sender, const gchar* path, const gchar* interface,
+					const gchar* signal, GVariant* parameters, gpointer data) {
+					Audit::Scope audit(Audit::KIND_DBUS, "screensaver ActiveChanged");
+					setScreenSaverActive(parameters);
+				},
+				nullptr, nullptr));
+
+		// the screen may be locked already, when the panel restarts
+		mCancellable = g_cancellable_new();
+		g_dbus_connection_call(mConnection, "org.freedesktop.ScreenSaver", "/org/freedesktop/ScreenSaver",
+			"org.freedesktop.ScreenSaver", "GetActive", nullptr, G_VARIANT_TYPE("(b)"),
+			G_DBUS_CALL_FLAGS_NO_AUTO_START, -1, mCancellable,
+			[](GObject* source, GAsyncResult* result, gpointer data) {
+				GVariant* reply = g_dbus_connection_call_finish(G_DBUS_CONNECTION(source), result, nullptr);
+
+				// no screensaver, or we are finalized already
+				if (reply == nullptr)
+					return;
+
+				setScreenSaverActive(reply);
+				g_variant_unref(reply);
+			},
+			nullptr);
+	}
+
+	void finalize()
+	{
+		if (mSuspendStart != 0)
+		{
+			mSuspendedTime += g_get_monotonic_time() - mSuspendStart;
+			mSuspendedWakeups += Help::Gtk::getWakeups() - mSuspendStartWakeups;
+		}
+
+		if (mSuspendedTime > 0)
+			g_debug("Power saver: suspended %u times for %" G_GINT64_FORMAT " s, %.1f wakeups per minute meanwhile",
+				mSuspends, mSuspendedTime / G_USEC_PER_SEC, mSuspendedWakeups * 60.0 * G_USEC_PER_SEC / mSuspendedTime);
+
+		mRecheck.stop();
+		disconnectToplevel();
+
+		for (gulong id : mHandlerIds)
+			g_signal_handler_disconnect(G_OBJECT(Plugin::mXfPlugin), id);
+
+		if (mCancellable != nullptr)
+		{
+			g_cancellable_cancel(mCancellable);
+			g_object_unref(mCancellable);
+		}
+
+		if (mConnection != nullptr)
+		{
+			for (guint id : mSignalIds)
+				g_dbus_connection_signal_unsubscribe(mConnection, id);
+			g_object_unref(mConnection);
+		}
+
+		mHandlerIds.clear();
+		mSignalIds.clear();
+		mCancellable = nullptr;
+		mConnection = nullptr;
+		mPanelVisible = mObscured = mScreenSaverActive = mSuspended = false;
+		mSuspends = mSuspendedWakeups = 0;
+		mSuspendedTime = mSuspendStart = 0;
+	}
+
+	bool isSuspended()
+	{
+		return mSuspended;
+	}
+} // namespace PowerSaver
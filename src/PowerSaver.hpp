@@ -0,0 +1,34 @@
+/*
+ * Copyright (c) 2019-2020 Nicolas Szabo <nszabo@vivaldi.net>
+ * Copyright (c) 2020-2021 David Keogh <davidtkeogh@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef POWER_SAVER_HPP
+#define POWER_SAVER_HPP
+
+// Pauses the dock's periodic work while nobody can see it: when the panel is hidden, and
+// while the screensaver is active, which covers locked and idle blanked screens. The
+// screensaver is watched on the session bus, a test bus can stand in for it through
+// DBUS_SESSION_BUS_ADDRESS. What changed meanwhile is caught up on resume.
+namespace PowerSaver
+{
+	void init();
+	void finalize();
+
+	bool isSuspended();
+} // namespace PowerSaver
+
+#endif // POWER_SAVER_HPP
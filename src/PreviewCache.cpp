@@ -0,0 +1,143 @@
+/*
+ * Copyright (c) 2019-2020 Nicolas Szabo <nszabo@vivaldi.net>
+ * Copyright (c) 2020-2021 David Keogh <davidtkeogh@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "PreviewCache.hpp"
+#include "Settings.hpp"
+
+#include <list>
+#include <map>
+
+namespace PreviewCache
+{
+	struct Entry
+	{
+		XfwWindow* window;
+		cairo_surface_t* surface;
+		gint64 timestamp;
+		size_t size;
+	};
+
+	// most recently used first
+	std::list<Entry> mEntries;
+	std::map<XfwWindow*, std::list<Entry>::iterator> mIndex;
+	size_t mSize = 0;
+
+	uint mHits = 0;
+	uint mMisses = 0;
+	uint mEvictions = 0;
+
+	static size_t getBudget()
+	{
+		int megabytes = Settings::previewCacheSize > 0 ? Settings::previewCacheSize : 32;
+		return (size_t)megabytes << 20;
+	}
+
+	static void evict(size_t budget)
+	{
+		// the entry just stored is never dropped, however large it is
+		while (mSize > budget && mEntries.size() > 1)
+		{
+			Entry& entry = mEntries.back();
+
+			mSize -= entry.size;
+			cairo_surface_destroy(entry.surface);
+			mIndex.erase(entry.window);
+			mEntries.pop_back();
+			++mEvictions;
+		}
+	}
+
+	void finalize()
+	{
+		g_debug("Preview cache: %u hits, %u misses, %u evictions, %" G_GSIZE_FORMAT " bytes in %" G_GSIZE_FORMAT " previews",
+			mHits, mMisses, mEvictions, mSize, mEntries.size());
+
+		for (Entry& entry : mEntries)
+			cairo_surface_destroy(entry.surface);
+
+		mEntries.clear();
+		mIndex.clear();
+		mSize = 0;
+		mHits = mMisses = mEvictions = 0;
+	}
+
+	cairo_surface_t* store(XfwWindow* window, cairo_surface_t* surface)
+	{
+		cairo_surface_t* replaced = nullptr;
+		std::map<XfwWindow*, std::list<Entry>::iterator>::iterator it = mIndex.find(window);
+
+		if (it != mIndex.end())
+		{
+			replaced = it->second->surface;
+			mSize -= it->second->size;
+			mEntries.erase(it->second);
+		}
+
+		Entry entry;
+		entry.window = window;
+		entry.surface = surface;
+		entry.timestamp = g_get_monotonic_time();
+		entry.size = (size_t)cairo_image_surface_get_stride(surface) * cairo_image_surface_get_height(surface);
+
+		mEntries.push_front(entry);
+		mIndex[window] = mEntries.begin();
+		mSize += entry.size;
+
+		evict(getBudget());
+
+		return replaced;
+	}
+
+	cairo_surface_t* lookup(XfwWindow* window)
+	{
+		std::map<XfwWindow*, std::list<Entry>::iterator>::iterator it = mIndex.find(window);
+
+		if (it == mIndex.end())
+		{
+			++mMisses;
+			return nullptr;
+		}
+
+		++mHits;
+		mEntries.splice(mEntries.begin(), mEntries, it->second);
+		return it->second->surface;
+	}
+
+	bool contains(XfwWindow* window)
+	{
+		return mIndex.find(window) != mIndex.end();
+	}
+
+	gint64 timestamp(XfwWindow* window)
+	{
+		std::map<XfwWindow*, std::list<Entry>::iterator>::iterator it = mIndex.find(window);
+		return it != mIndex.end() ? it->second->timestamp : 0;
+	}
+
+	void remove(XfwWindow* window)
+	{
+		std::map<XfwWindow*, std::list<Entry>::iterator>::iterator it = mIndex.find(window);
+		if (it == mIndex.end())
+			return;
+
+		mSize -= it->second->size;
+		cairo_surface_destroy(it->second->surface);
+		mEntries.erase(it->second);
+		mIndex.erase(it);
+	}
+} // namespace PreviewCache
@@ -0,0 +1,44 @@
+/*
+ * Copyright (c) 2019-2020 Nicolas Szabo <nszabo@vivaldi.net>
+ * Copyright (c) 2020-2021 David Keogh <davidtkeogh@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef PREVIEW_CACHE_HPP
+#define PREVIEW_CACHE_HPP
+
+#include <gtk/gtk.h>
+#include <libxfce4windowing/libxfce4windowing.h>
+
+// Last preview of each window, kept under a memory budget with the least recently used
+// previews dropped first. It outlives menu items, so that popups never start out empty.
+namespace PreviewCache
+{
+	void finalize();
+
+	// Takes over the surface. Returns the one it replaces for reuse, or nullptr.
+	cairo_surface_t* store(XfwWindow* window, cairo_surface_t* surface);
+
+	// The window's preview, marked as the most recently used, or nullptr
+	cairo_surface_t* lookup(XfwWindow* window);
+	bool contains(XfwWindow* window);
+
+	// Monotonic time of the window's last capture, or 0
+	gint64 timestamp(XfwWindow* window);
+
+	void remove(XfwWindow* window);
+} // namespace PreviewCache
+
+#endif // PREVIEW_CACHE_HPP
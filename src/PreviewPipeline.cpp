@@ -0,0 +1,361 @@
+/*
+ * Copyright (c) 2019-2020 Nicolas Szabo <nszabo@vivaldi.net>
+ * Copyright (c) 2020-2021 David Keogh <davidtkeogh@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "PreviewPipeline.hpp"
+#include "Audit.hpp"
+#include "GroupMenuItem.hpp"
+#include "PreviewCache.hpp"
+#include "Settings.hpp"
+#include "Trace.hpp"
+#include "WindowCapture.hpp"
+
+#include <atomic>
+#include <map>
+
+namespace PreviewPipeline
+{
+	struct Job
+	{
+		GroupMenuItem* item; // nullptr for a prefetch
+		XfwWindow* window;
+		guint64 serial;
+		WindowCapture::Frame frame;
+		cairo_surface_t* target;
+		gint64 workTime;
+		Job* next;
+	};
+
+	struct Pending
+	{
+		guint64 serial;
+		bool again;
+	};
+
+	GThreadPool* mPool = nullptr;
+
+	// Finished jobs, pushed by the workers and taken all at once by the main loop
+	std::atomic<Job*> mCompleted(nullptr);
+	std::atomic<bool> mDrainScheduled(false);
+
+	// Main thread only: the job each item is waiting for. Results that don't match are stale.
+	std::map<GroupMenuItem*, Pending> mPending;
+	// the same for prefetches, which have no menu item
+	std::map<XfwWindow*, guint64> mPrefetching;
+	guint64 mSerial = 0;
+
+	// the surface last replaced in the cache by a prefetch, refilled by the next one
+	cairo_surface_t* mSpareSurface = nullptr;
+
+	uint mRefreshes = 0;
+	uint mDiscarded = 0;
+	uint mSkipped = 0;
+
+	// captures and skipped refreshes over the last second, for debug output
+	gint64 mRateStart = 0;
+	uint mRateCaptures = 0;
+	uint mRateSkipped = 0;
+	gint64 mMainThreadTime = 0;
+	gint64 mWorkerTime = 0;
+
+	static void scale(Job* job)
+	{
+		TRACE_SPAN("PreviewPipeline::scale");
+		gint64 start = g_get_monotonic_time();
+		const WindowCapture::Frame& frame = job->frame;
+
+		Scaler::scaleToFit(frame.pixels, frame.format, frame.width, frame.height, frame.stride, job->target);
+		job->workTime = g_get_monotonic_time() - start;
+	}
+
+	static void countRate(bool captured)
+	{
+		gint64 now = g_get_monotonic_time();
+
+		if (now - mRateStart >= G_USEC_PER_SEC)
+		{
+			if (mRateCaptures + mRateSkipped > 0)
+				g_debug("Preview pipeline: %u captures/s, %u skipped unchanged", mRateCaptures, mRateSkipped);
+
+			mRateStart = now;
+			mRateCaptures = mRateSkipped = 0;
+		}
+
+		if (captured)
+			++mRateCaptures;
+		else
+			++mRateSkipped;
+	}
+
+	static void finishPrefetch(Job* job)
+	{
+		std::map<XfwWindow*, guint64>::iterator it = mPrefetching.find(job->window);
+
+		if (it == mPrefetching.end() || it->second != job->serial)
+		{
+			++mDiscarded;
+			cairo_surface_destroy(job->target);
+			return;
+		}
+
+		mPrefetching.erase(it);
+
+		if (mSpareSurface != nullptr)
+			cairo_surface_destroy(mSpareSurface);
+		mSpareSurface = PreviewCache::store(job->window, job->target);
+	}
+
+	static void finish(Job* job)
+	{
+		gint64 start = g_get_monotonic_time();
+		GroupMenuItem* item = job->item;
+
+		if (item == nullptr)
+		{
+			WindowCapture::release(&job->frame);
+			mWorkerTime += job->workTime;
+			finishPrefetch(job);
+			delete job;
+			mMainThreadTime += g_get_monotonic_time() - start;
+			return;
+		}
+
+		std::map<GroupMenuItem*, Pending>::iterator it = mPending.find(item);
+
+		WindowCapture::release(&job->frame);
+		mWorkerTime += job->workTime;
+
+		if (it == mPending.end() || it->second.serial != job->serial)
+		{
+			++mDiscarded;
+			cairo_surface_destroy(job->target);
+			delete job;
+			return;
+		}
+
+		bool again = it->second.again;
+		mPending.erase(it);
+
+		item->presentPreview(job->target);
+		delete job;
+
+		mMainThreadTime += g_get_monotonic_time() - start;
+
+		if (again)
+			request(item);
+	}
+
+	static gboolean drain(gpointer data)
+	{
+		Audit::Scope audit(Audit::KIND_IDLE, "preview pipeline drain");
+
+		// cleared first, so that a job completing from now on schedules another run
+		mDrainScheduled.store(false, std::memory_order_release);
+		Job* jobs = mCompleted.exchange(nullptr, std::memory_order_acquire);
+
+		// the stack pops in reverse completion order
+		Job* ordered = nullptr;
+		while (jobs != nullptr)
+		{
+			Job* next = jobs->next;
+			jobs->next = ordered;
+			ordered = jobs;
+			jobs = next;
+		}
+
+		while (ordered != nullptr)
+		{
+			Job* job = ordered;
+			ordered = job->next;
+			finish(job);
+		}
+
+		return G_SOURCE_REMOVE;
+	}
+
+	static void work(gpointer data, gpointer userData)
+	{
+		Job* job = (Job*)data;
+		scale(job);
+
+		job->next = mCompleted.load(std::memory_order_relaxed);
+		while (!mCompleted.compare_exchange_weak(job->next, job, std::memory_order_release, std::memory_order_relaxed))
+			;
+
+		// g_idle_add is safe from any thread, the flag keeps it to one pending source
+		if (!mDrainScheduled.exchange(true, std::memory_order_acq_rel))
+			g_idle_add(drain, &mCompleted);
+	}
+
+	void init()
+	{
+		GError* error = nullptr;
+		int threads = CLAMP((int)g_get_num_processors() - 1, 1, 2);
+
+		// pick the scaler before several threads race to do it
+		g_debug("Preview pipeline: %d threads, %s scaler", threads, Scaler::implementation());
+
+		mPool = g_thread_pool_new(work, nullptr, threads, false, &error);
+		if (mPool == nullptr)
+		{
+			g_warning("Unable to start preview threads, scaling on the main thread: %s", error->message);
+			g_error_free(error);
+		}
+	}
+
+	void finalize()
+	{
+		// let queued jobs complete, their frames and surfaces are released by the drain below
+		if (mPool != nullptr)
+			g_thread_pool_free(mPool, false, true);
+		mPool = nullptr;
+
+		g_idle_remove_by_data(&mCompleted);
+		mPending.clear();
+		mPrefetching.clear();
+		drain(nullptr);
+
+		if (mSpareSurface != nullptr)
+			cairo_surface_destroy(mSpareSurface);
+		mSpareSurface = nullptr;
+
+		if (mRefreshes > 0)
+			g_debug("Preview pipeline: %u refreshes, %" G_GINT64_FORMAT " us per refresh on the main thread, "
+					"%" G_GINT64_FORMAT " us per refresh on workers, %u stale results dropped, %u skipped unchanged",
+				mRefreshes, mMainThreadTime / mRefreshes, mWorkerTime / mRefreshes, mDiscarded, mSkipped);
+
+		mRefreshes = mDiscarded = mSkipped = 0;
+		mRateStart = 0;
+		mRateCaptures = mRateSkipped = 0;
+		mMainThreadTime = mWorkerTime = 0;
+	}
+
+	static void push(Job* job)
+	{
+		if (mPool != nullptr)
+			g_thread_pool_push(mPool, job, nullptr);
+		else
+		{
+			// no workers: the scaling is main thread time as well
+			scale(job);
+			mMainThreadTime += job->workTime;
+			job->workTime = 0;
+			finish(job);
+		}
+	}
+
+	void request(GroupMenuItem* item)
+	{
+		std::map<GroupMenuItem*, Pending>::iterator it = mPending.find(item);
+		if (it != mPending.end())
+		{
+			it->second.again = true;
+			return;
+		}
+
+		gint64 start = g_get_monotonic_time();
+		cairo_surface_t* target = item->takePreviewTarget();
+
+		if (target == nullptr)
+			return;
+
+		Job* job = new Job();
+		job->item = item;
+		job->window = item->mGroupWindow->mXfwWindow;
+		job->serial = ++mSerial;
+		job->target = target;
+
+		if (!WindowCapture::acquire(job->window,
+				cairo_image_surface_get_width(target), cairo_image_surface_get_height(target), &job->frame))
+		{
+			item->recyclePreviewTarget(target);
+			delete job;
+			return;
+		}
+
+		++mRefreshes;
+		countRate(true);
+		mPending[item] = {job->serial, false};
+		mMainThreadTime += g_get_monotonic_time() - start;
+		push(job);
+	}
+
+	void forget(GroupMenuItem* item)
+	{
+		mPending.erase(item);
+	}
+
+	void prefetch(XfwWindow* window, int scale)
+	{
+		if (mPrefetching.find(window) != mPrefetching.end())
+			return;
+
+		gint64 start = g_get_monotonic_time();
+		gint width = Settings::previewWidth * scale;
+		gint height = Settings::previewHeight * scale;
+		cairo_surface_t* target = mSpareSurface;
+
+		mSpareSurface = nullptr;
+
+		if (target == nullptr
+			|| cairo_image_surface_get_width(target) != width
+			|| cairo_image_surface_get_height(target) != height)
+		{
+			if (target != nullptr)
+				cairo_surface_destroy(target);
+
+			target = cairo_image_surface_create(CAIRO_FORMAT_ARGB32, width, height);
+			if (cairo_surface_status(target) != CAIRO_STATUS_SUCCESS)
+			{
+				cairo_surface_destroy(target);
+				return;
+			}
+		}
+
+		cairo_surface_set_device_scale(target, scale, scale);
+
+		Job* job = new Job();
+		job->item = nullptr;
+		job->window = window;
+		job->serial = ++mSerial;
+		job->target = target;
+
+		if (!WindowCapture::acquire(window, width, height, &job->frame))
+		{
+			mSpareSurface = target;
+			delete job;
+			return;
+		}
+
+		++mRefreshes;
+		countRate(true);
+		mPrefetching[window] = job->serial;
+		mMainThreadTime += g_get_monotonic_time() - start;
+		push(job);
+	}
+
+	void forget(XfwWindow* window)
+	{
+		mPrefetching.erase(window);
+	}
+
+	void countSkipped()
+	{
+		++mSkipped;
+		countRate(false);
+	}
+} // namespace PreviewPipeline
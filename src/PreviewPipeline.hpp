@@ -0,0 +1,49 @@
+/*
+ * Copyright (c) 2019-2020 Nicolas Szabo <nszabo@vivaldi.net>
+ * Copyright (c) 2020-2021 David Keogh <davidtkeogh@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef PREVIEW_PIPELINE_HPP
+#define PREVIEW_PIPELINE_HPP
+
+#include <libxfce4windowing/libxfce4windowing.h>
+
+class GroupMenuItem;
+
+// Window previews are read on the main thread, scaled by a pool of worker threads and handed
+// back to their menu item from the main loop.
+namespace PreviewPipeline
+{
+	void init();
+	void finalize();
+
+	// Captures the item's window now and queues it for scaling. While an update of the item
+	// is in flight, another one is done right after it instead.
+	void request(GroupMenuItem* item);
+
+	// Drops anything in flight for an item that is going away
+	void forget(GroupMenuItem* item);
+
+	// Captures a window straight into the preview cache, for windows without a menu item.
+	// Does nothing while a capture of the window is in flight already.
+	void prefetch(XfwWindow* window, int scale);
+	void forget(XfwWindow* window);
+
+	// Counts a refresh that was not needed because the window did not change
+	void countSkipped();
+} // namespace PreviewPipeline
+
+#endif // PREVIEW_PIPELINE_HPP
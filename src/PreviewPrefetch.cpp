@@ -0,0 +1,407 @@
+/*
+ * Copyright (c) 2019-2020 Nicolas Szabo <nszabo@vivaldi.net>
+ * Copyright (c) 2020-2021 David Keogh <davidtkeogh@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "PreviewPrefetch.hpp"
+#include "Dock.hpp"
+#include "Group.hpp"
+#include "GroupMenuItem.hpp"
+#include "PowerSaver.hpp"
+#include "PreviewCache.hpp"
+#include "PreviewPipeline.hpp"
+
+#include <algorithm>
+#include <list>
+#include <set>
+#include <vector>
+
+namespace PreviewPrefetch
+{
+	// main thread time allowed for prefetching, per second
+	const gint64 mBudget = 20000;
+	// The pointer is sampled often only while it is near the dock and moving. Over the dock,
+	// motion events report it, and a pointer left still is no longer sampled at all until it
+	// crosses the dock again.
+	const uint mNearInterval = 100;
+	const uint mFarInterval = 250;
+	const uint mStillSamples = 3;
+	// a pointer this close to the dock, and moving towards it this fast, is about to hover it
+	const int mApproachDistance = 150;
+	const int mApproachSpeed = 400; // px/s
+	// don't prefetch again what was captured more recently than this
+	const gint64 mMinAge = G_USEC_PER_SEC;
+
+	std::list<XfwWindow*> mRecent;
+	std::list<XfwWindow*> mQueue;
+	std::set<XfwWindow*> mPrefetched;
+
+	Help::Gtk::Timeout mPointerWatch;
+	Help::Gtk::Timeout mResume;
+	Help::Gtk::Idle mWork;
+
+	gint64 mBudgetStart = 0;
+	gint64 mBudgetSpent = 0;
+
+	int mLastDistance = -1;
+	gint64 mLastPointerTime = 0;
+	int mLastX = -1;
+	int mLastY = -1;
+	uint mPointerInterval = mNearInterval;
+	uint mPointerSamples = 0;
+	uint mPointerStill = 0;
+
+	uint mPrefetches = 0;
+	uint mHits = 0;
+	uint mStale = 0;
+	uint mMisses = 0;
+	gint64 mTime = 0;
+
+	static bool enabled()
+	{
+		return Settings::previewPrefetch > 0 && Settings::showPreviews;
+	}
+
+	// Whether the window's cached preview may be out of date. Windows with a menu item
+	// have their changes tracked, the others are captured again once old enough.
+	static bool outdated(GroupWindow* groupWindow, gint64 now)
+	{
+		GroupMenuItem* item = groupWindow->mGroupMenuItem;
+
+		if (item != nullptr)
+			return item->previewOutdated() && now - item->mPreviewTime >= mMinAge;
+
+		return now - PreviewCache::timestamp(groupWindow->mXfwWindow) >= mMinAge;
+	}
+
+	static void queue(XfwWindow* window)
+	{
+		if (std::find(mQueue.begin(), mQueue.end(), window) == mQueue.end())
+			mQueue.push_back(window);
+
+		if (mWork.mIdleId == 0 && mResume.mTimeoutId == 0 && !PowerSaver::isSuspended())
+			mWork.start();
+	}
+
+	static bool work()
+	{
+		gint64 now = g_get_monotonic_time();
+
+		if (now - mBudgetStart >= G_USEC_PER_SEC)
+		{
+			mBudgetStart = now;
+			mBudgetSpent = 0;
+		}
+
+		// over budget, wait for the next second
+		if (mBudgetSpent >= mBudget)
+		{
+			mResume.setup((mBudgetStart + G_USEC_PER_SEC - now) / 1000 + 1, []() {
+				mWork.start();
+				return false;
+			});
+			mResume.start();
+			return false;
+		}
+
+		while (!mQueue.empty())
+		{
+			XfwWindow* window = mQueue.front();
+			std::shared_ptr<GroupWindow> groupWindow = Xfw::mGroupWindows.get(window);
+			mQueue.pop_front();
+
+			// open popups are refreshed by the preview scheduler
+			if (!groupWindow || groupWindow->mGroup == nullptr || groupWindow->mGroup->mGroupMenu.mVisible
+				|| groupWindow->getState(XFW_WINDOW_STATE_MINIMIZED)
+				|| !outdated(groupWindow.get(), now))
+				continue;
+
+			// menu items are only built once a popup needs them
+			if (groupWindow->mGroupMenuItem != nullptr)
+				groupWindow->mGroupMenuItem->updatePreview();
+			else
+				PreviewPipeline::prefetch(window, gtk_widget_get_scale_factor(Dock::mBox));
+
+			gint64 spent = g_get_monotonic_time() - now;
+			mBudgetSpent += spent;
+			mTime += spent;
+			++mPrefetches;
+			mPrefetched.insert(window);
+			break; // one capture per main loop iteration
+		}
+
+		return !mQueue.empty();
+	}
+
+	static void queueGroup(Group* group)
+	{
+		group->mWindows.forEach([](GroupWindow* w) -> void {
+			queue(w->mXfwWindow);
+		});
+	}
+
+	// Queues the groups around `position` along the dock, nearest first
+	static void queueNearbyGroups(int position)
+	{
+		std::vector<std::pair<int, Group*>> groups;
+
+		Dock::mGroups.forEach([&groups, position](std::pair<std::shared_ptr<AppInfo>, std::shared_ptr<Group>> g) -> void {
+			Group* group = g.second.get();
+			GtkAllocation allocation;
+
+			if (!group->mWindowsCount || !gtk_widget_get_mapped(group->mButton))
+				return;
+
+			gtk_widget_get_allocation(group->mButton, &allocation);
+
+			bool horizontal = xfce_panel_plugin_get_mode(Plugin::mXfPlugin) == XFCE_PANEL_PLUGIN_MODE_HORIZONTAL;
+			int x, y;
+			gtk_widget_translate_coordinates(group->mButton, Dock::mBox, allocation.width / 2, allocation.height / 2, &x, &y);
+			groups.emplace_back(abs((horizontal ? x : y) - position), group);
+		});
+
+		std::sort(groups.begin(), groups.end());
+
+		for (size_t i = 0; i < groups.size() && i < 2; ++i)
+			queueGroup(groups[i].second);
+	}
+
+	// Returns the pointer distance to the dock, or -1 when the dock is not shown
+	static int checkPointer(int px, int py)
+	{
+		GdkWindow* window = gtk_widget_get_window(Dock::mBox);
+
+		if (window == nullptr || !gtk_widget_get_mapped(Dock::mBox))
+		{
+			mLastDistance = -1;
+			return -1;
+		}
+
+		gint ox, oy;
+		GtkAllocation allocation;
+		gdk_window_get_origin(window, &ox, &oy);
+		gtk_widget_get_allocation(Dock::mBox, &allocation);
+
+		// pointer relative to the dock
+		px -= ox + allocation.x;
+		py -= oy + allocation.y;
+
+		bool horizontal = xfce_panel_plugin_get_mode(Plugin::mXfPlugin) == XFCE_PANEL_PLUGIN_MODE_HORIZONTAL;
+		int along = horizontal ? px : py;
+		int across = horizontal ? py : px;
+		int length = horizontal ? allocation.width : allocation.height;
+		int thickness = horizontal ? allocation.height : allocation.width;
+
+		int distance = across < 0 ? -across : std::max(across - thickness, 0);
+		gint64 now = g_get_monotonic_time();
+
+		int speed = 0;
+		if (mLastDistance >= 0 && now > mLastPointerTime)
+			speed = (mLastDistance - distance) * G_USEC_PER_SEC / (now - mLastPointerTime);
+
+		bool approaching = distance > 0 && distance <= mApproachDistance && speed >= mApproachSpeed;
+		bool arrived = distance == 0 && mLastDistance != 0;
+
+		if ((approaching || arrived) && along >= -mApproachDistance && along <= length + mApproachDistance)
+		{
+			queueNearbyGroups(along);
+
+			for (XfwWindow* recent : mRecent)
+				queue(recent);
+		}
+
+		mLastDistance = distance;
+		mLastPointerTime = now;
+
+		return distance;
+	}
+
+	static bool watchPointer()
+	{
+		gint px, py;
+		gdk_device_get_position(Plugin::mPointer, nullptr, &px, &py);
+		++mPointerSamples;
+
+		bool moved = px != mLastX || py != mLastY;
+		int distance = checkPointer(px, py);
+		mLastX = px;
+		mLastY = py;
+
+		// over the dock, or with the dock hidden, crossing events take over
+		if (distance <= 0)
+			return false;
+
+		if (moved)
+		{
+			mPointerStill = 0;
+			mPointerInterval = distance <= 2 * mApproachDistance ? mNearInterval : mFarInterval;
+		}
+		else if (++mPointerStill >= mStillSamples)
+			return false;
+		else
+			mPointerInterval *= 2;
+
+		// taken by the wheel when it rearms the timer
+		mPointerWatch.mDuration = mPointerInterval;
+		return true;
+	}
+
+	static void startWatch()
+	{
+		if (mPointerWatch.mTimeoutId != 0)
+			return;
+
+		mPointerStill = 0;
+		mPointerInterval = mNearInterval;
+		mPointerWatch.setup(mPointerInterval, watchPointer);
+		mPointerWatch.start();
+	}
+
+	void pointerMoved(int x, int y)
+	{
+		if (!enabled() || PowerSaver::isSuspended())
+			return;
+
+		// off the dock, motion events stop coming: sample the pointer from now on
+		if (checkPointer(x, y) > 0)
+			startWatch();
+
+		mLastX = x;
+		mLastY = y;
+	}
+
+	void pointerLeft(int x, int y)
+	{
+		if (!enabled() || PowerSaver::isSuspended())
+			return;
+
+		checkPointer(x, y);
+		mLastX = x;
+		mLastY = y;
+		startWatch();
+	}
+
+	void init()
+	{
+		mWork.setup(work, Help::Gtk::JOB_LOW);
+		settingsChanged();
+	}
+
+	void finalize()
+	{
+		mPointerWatch.stop();
+		mResume.stop();
+		mWork.stop();
+
+		if (mPointerSamples > 0)
+			g_debug("Preview prefetch: %u pointer samples", mPointerSamples);
+
+		if (mPrefetches > 0)
+		{
+			uint shown = mHits + mStale + mMisses;
+			g_debug("Preview prefetch: %u captures in %" G_GINT64_FORMAT " us, %u of %u popup previews served (%u%%), %u outdated or evicted by then",
+				mPrefetches, mTime, mHits, shown, shown > 0 ? mHits * 100 / shown : 0, mStale);
+		}
+
+		mRecent.clear();
+		mQueue.clear();
+		mPrefetched.clear();
+		mPrefetches = mHits = mStale = mMisses = mPointerSamples = 0;
+		mTime = 0;
+	}
+
+	void settingsChanged()
+	{
+		if (enabled())
+		{
+			if (!PowerSaver::isSuspended())
+				startWatch();
+
+			while (mRecent.size() > (size_t)Settings::previewPrefetch)
+				mRecent.pop_back();
+		}
+		else
+		{
+			mPointerWatch.stop();
+			mResume.stop();
+			mWork.stop();
+			mRecent.clear();
+			mQueue.clear();
+			mLastDistance = -1;
+		}
+	}
+
+	void powerChanged()
+	{
+		if (PowerSaver::isSuspended())
+		{
+			mPointerWatch.stop();
+			mResume.stop();
+			mWork.stop();
+			mLastDistance = -1;
+			return;
+		}
+
+		settingsChanged();
+
+		if (enabled() && !mQueue.empty())
+			mWork.start();
+	}
+
+	void windowActivated(XfwWindow* window, XfwWindow* previousWindow)
+	{
+		if (!enabled())
+			return;
+
+		if (window != nullptr)
+		{
+			mRecent.remove(window);
+			mRecent.push_front(window);
+
+			if (mRecent.size() > (size_t)Settings::previewPrefetch)
+				mRecent.pop_back();
+		}
+
+		// the window left behind is the one most likely looked for in a popup next
+		if (previousWindow != nullptr)
+			queue(previousWindow);
+	}
+
+	void forget(XfwWindow* window)
+	{
+		mRecent.remove(window);
+		mQueue.remove(window);
+		mPrefetched.erase(window);
+		PreviewPipeline::forget(window);
+	}
+
+	void popupShown(Group* group)
+	{
+		if (!enabled())
+			return;
+
+		group->mWindows.forEach([](GroupWindow* w) -> void {
+			GroupMenuItem* item = w->mGroupMenuItem;
+
+			if (mPrefetched.erase(w->mXfwWindow) == 0)
+				++mMisses;
+			else if (PreviewCache::contains(w->mXfwWindow) && (item == nullptr || !item->mPreviewDirty))
+				++mHits;
+			else
+				++mStale;
+		});
+	}
+} // namespace PreviewPrefetch
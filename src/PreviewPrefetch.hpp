@@ -0,0 +1,51 @@
+/*
+ * Copyright (c) 2019-2020 Nicolas Szabo <nszabo@vivaldi.net>
+ * Copyright (c) 2020-2021 David Keogh <davidtkeogh@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef PREVIEW_PREFETCH_HPP
+#define PREVIEW_PREFETCH_HPP
+
+#include <libxfce4windowing/libxfce4windowing.h>
+
+class Group;
+
+// Optionally warms the preview cache before a popup asks for it: for the most recently used
+// windows, and for the groups under a pointer that is heading for the dock. Captures run at
+// idle priority, within a main thread time budget.
+namespace PreviewPrefetch
+{
+	void init();
+	void finalize();
+
+	// follows Settings::previewPrefetch, the number of recent windows to keep warm
+	void settingsChanged();
+	// pauses or resumes with the power saver, keeping what was queued
+	void powerChanged();
+
+	// Checks the pointer against the dock from its motion and crossing events. Off the dock,
+	// the pointer is sampled until it stays still.
+	void pointerMoved(int x, int y);
+	void pointerLeft(int x, int y);
+
+	void windowActivated(XfwWindow* window, XfwWindow* previousWindow);
+	void forget(XfwWindow* window);
+
+	// Counts which of the group's previews were served by the prefetcher
+	void popupShown(Group* group);
+} // namespace PreviewPrefetch
+
+#endif // PREVIEW_PREFETCH_HPP
@@ -0,0 +1,191 @@
+/*
+ * Copyright (c) 2019-2020 Nicolas Szabo <nszabo@vivaldi.net>
+ * Copyright (c) 2020-2021 David Keogh <davidtkeogh@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "PreviewScheduler.hpp"
+#include "GroupMenuItem.hpp"
+#include "PowerSaver.hpp"
+#include "Settings.hpp"
+#include "WindowCapture.hpp"
+
+#include <algorithm>
+#include <map>
+#include <vector>
+
+namespace PreviewScheduler
+{
+	// main thread time spent on refreshes before the rest waits for the next iteration
+	const gint64 mFrameBudget = 4000;
+
+	std::map<GroupMenuItem*, Priority> mItems;
+
+	// armed for the next rate limited refresh only, damage wakes the scheduler otherwise
+	Help::Gtk::Timeout mNext;
+	Help::Gtk::Idle mContinue;
+
+	uint mRuns = 0;
+	uint mRefreshes = 0;
+	uint mDeferred = 0;
+	uint mOffscreen = 0;
+
+	static gint64 refreshInterval(Priority priority)
+	{
+		int maxFps = Settings::previewMaxFps > 0 ? Settings::previewMaxFps : 5;
+		gint64 hovered = 1000 / CLAMP(maxFps, 1, 60);
+
+		if (priority == PRIORITY_HOVERED)
+			return hovered * 1000;
+
+		gint64 visible = Settings::previewSleep > 0 ? Settings::previewSleep : 1000;
+		return std::max(visible, hovered) * 1000;
+	}
+
+	static void arm(gint64 next, gint64 now)
+	{
+		mNext.stop();
+
+		if (next == G_MAXINT64)
+			return;
+
+		mNext.setup((next - now) / 1000 + 1, []() {
+			wake();
+			return false;
+		});
+		mNext.start();
+	}
+
+	// Refreshes what is due, returns whether some of it had to wait for the budget.
+	// Otherwise the timer is armed for the earliest outdated preview that is rate limited.
+	static bool run()
+	{
+		gint64 now = g_get_monotonic_time();
+		gint64 next = G_MAXINT64;
+		std::vector<std::pair<Priority, GroupMenuItem*>> due;
+
+		++mRuns;
+
+		for (const auto& entry : mItems)
+		{
+			GroupMenuItem* item = entry.first;
+
+			if (item->mGroupWindow->getState(XFW_WINDOW_STATE_MINIMIZED) || !item->previewOutdated())
+				continue;
+
+			gint64 dueTime = item->mPreviewTime + refreshInterval(entry.second);
+			if (dueTime > now)
+			{
+				next = std::min(next, dueTime);
+				continue;
+			}
+
+			if (entry.second == PRIORITY_VISIBLE && !item->previewOnScreen())
+			{
+				++mOffscreen;
+				continue;
+			}
+
+			due.emplace_back(entry.second, item);
+		}
+
+		// hovered first, then the previews that waited the longest
+		std::sort(due.begin(), due.end(), [](const std::pair<Priority, GroupMenuItem*>& a, const std::pair<Priority, GroupMenuItem*>& b) {
+			if (a.first != b.first)
+				return a.first > b.first;
+			return a.second->mPreviewTime < b.second->mPreviewTime;
+		});
+
+		for (const auto& entry : due)
+		{
+			if (g_get_monotonic_time() - now >= mFrameBudget)
+			{
+				++mDeferred;
+				return true;
+			}
+
+			entry.second->updatePreview();
+			++mRefreshes;
+		}
+
+		arm(next, now);
+		return false;
+	}
+
+	void wake()
+	{
+		if (!mItems.empty() && mContinue.mIdleId == 0)
+			mContinue.start();
+	}
+
+	void init()
+	{
+		// runs when refreshes start, on damage, when a rate limit expires, and again for
+		// whatever went over the budget
+		mContinue.setup([]() {
+			if (mItems.empty())
+				return false;
+
+			return run();
+		},
+			Help::Gtk::JOB_LOW);
+	}
+
+	void finalize()
+	{
+		stop();
+
+		if (mRuns > 0)
+			g_debug("Preview scheduler: %u runs, %u refreshes, %u deferred over budget, %u offscreen skipped",
+				mRuns, mRefreshes, mDeferred, mOffscreen);
+
+		mRuns = mRefreshes = mDeferred = mOffscreen = 0;
+	}
+
+	void setPriority(GroupMenuItem* item, Priority priority)
+	{
+		// the power saver reschedules open popups on resume
+		if (PowerSaver::isSuspended())
+			return;
+
+		if (priority == PRIORITY_NONE)
+		{
+			forget(item);
+			return;
+		}
+
+		Priority& current = mItems[item];
+		bool raised = current < priority;
+		current = priority;
+
+		if (raised)
+			wake();
+	}
+
+	void forget(GroupMenuItem* item)
+	{
+		mItems.erase(item);
+
+		if (mItems.empty())
+			stop();
+	}
+
+	void stop()
+	{
+		mItems.clear();
+		mNext.stop();
+		mContinue.stop();
+	}
+} // namespace PreviewScheduler
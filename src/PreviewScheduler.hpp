@@ -0,0 +1,49 @@
+/*
+ * Copyright (c) 2019-2020 Nicolas Szabo <nszabo@vivaldi.net>
+ * Copyright (c) 2020-2021 David Keogh <davidtkeogh@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef PREVIEW_SCHEDULER_HPP
+#define PREVIEW_SCHEDULER_HPP
+
+class GroupMenuItem;
+
+// Decides which window previews are refreshed and when. Refreshes run when a window reports
+// damage, or when its rate limit expires, and are limited to a time budget per main loop
+// iteration, most wanted previews first. Without damage tracking, previews are polled.
+namespace PreviewScheduler
+{
+	enum Priority
+	{
+		PRIORITY_NONE, // not refreshed
+		PRIORITY_VISIBLE, // refreshed slowly while on screen
+		PRIORITY_HOVERED, // refreshed at the highest rate
+	};
+
+	void init();
+	void finalize();
+
+	void setPriority(GroupMenuItem* item, Priority priority);
+	void forget(GroupMenuItem* item);
+
+	// Looks for due refreshes again, after damage or a change of what is visible
+	void wake();
+
+	// Stops all refreshes, until priorities are set again
+	void stop();
+} // namespace PreviewScheduler
+
+#endif // PREVIEW_SCHEDULER_HPP
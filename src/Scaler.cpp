@@ -0,0 +1,263 @@
+/*
+ * Copyright (c) 2019-2020 Nicolas Szabo <nszabo@vivaldi.net>
+ * Copyright (c) 2020-2021 David Keogh <davidtkeogh@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "Scaler.hpp"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define SCALER_X86 1
+#include <immintrin.h>
+#endif
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+namespace Scaler
+{
+	// Adds up the pixels of every source column box [bounds[i], bounds[i + 1]) of one row into
+	// sums[4 * i .. 4 * i + 3], channel by channel in memory order. A box average stays within
+	// 32 bits for any box below 16 million pixels.
+	typedef void (*AccumulateFunc)(const guint8* row, const int* bounds, int count, guint32* sums);
+
+	static void accumulateScalar(const guint8* row, const int* bounds, int count, guint32* sums)
+	{
+		for (int i = 0; i < count; ++i)
+		{
+			guint32 s0 = 0, s1 = 0, s2 = 0, s3 = 0;
+
+			for (const guint8* p = row + 4 * bounds[i]; p < row + 4 * bounds[i + 1]; p += 4)
+			{
+				s0 += p[0];
+				s1 += p[1];
+				s2 += p[2];
+				s3 += p[3];
+			}
+
+			sums[4 * i] += s0;
+			sums[4 * i + 1] += s1;
+			sums[4 * i + 2] += s2;
+			sums[4 * i + 3] += s3;
+		}
+	}
+
+	// 3 bytes per pixel never goes through the vector paths, the alpha sum is left untouched
+	static void accumulateRGB(const guint8* row, const int* bounds, int count, guint32* sums)
+	{
+		for (int i = 0; i < count; ++i)
+		{
+			guint32 s0 = 0, s1 = 0, s2 = 0;
+
+			for (const guint8* p = row + 3 * bounds[i]; p < row + 3 * bounds[i + 1]; p += 3)
+			{
+				s0 += p[0];
+				s1 += p[1];
+				s2 += p[2];
+			}
+
+			sums[4 * i] += s0;
+			sums[4 * i + 1] += s1;
+			sums[4 * i + 2] += s2;
+		}
+	}
+
+#ifdef SCALER_X86
+	__attribute__((target("sse2"))) static void accumulateSSE2(const guint8* row, const int* bounds, int count, guint32* sums)
+	{
+		const __m128i zero = _mm_setzero_si128();
+
+		for (int i = 0; i < count; ++i)
+		{
+			const guint8* p = row + 4 * bounds[i];
+			const guint8* end = row + 4 * bounds[i + 1];
+			__m128i acc = _mm_setzero_si128();
+
+			// four pixels at a time: widen to 16 bits, fold to two pixels, then widen to 32 bits
+			for (; p + 16 <= end; p += 16)
+			{
+				__m128i px = _mm_loadu_si128((const __m128i*)p);
+				__m128i pair = _mm_add_epi16(_mm_unpacklo_epi8(px, zero), _mm_unpackhi_epi8(px, zero));
+				acc = _mm_add_epi32(acc, _mm_unpacklo_epi16(pair, zero));
+				acc = _mm_add_epi32(acc, _mm_unpackhi_epi16(pair, zero));
+			}
+
+			for (; p < end; p += 4)
+			{
+				guint32 value;
+				memcpy(&value, p, 4);
+				__m128i px = _mm_unpacklo_epi8(_mm_cvtsi32_si128(value), zero);
+				acc = _mm_add_epi32(acc, _mm_unpacklo_epi16(px, zero));
+			}
+
+			__m128i sum = _mm_loadu_si128((const __m128i*)(sums + 4 * i));
+			_mm_storeu_si128((__m128i*)(sums + 4 * i), _mm_add_epi32(sum, acc));
+		}
+	}
+
+	__attribute__((target("avx2"))) static void accumulateAVX2(const guint8* row, const int* bounds, int count, guint32* sums)
+	{
+		for (int i = 0; i < count; ++i)
+		{
+			const guint8* p = row + 4 * bounds[i];
+			const guint8* end = row + 4 * bounds[i + 1];
+			__m256i acc = _mm256_setzero_si256();
+
+			// eight pixels at a time: widen to 16 bits and fold down to two pixels per 128 bit lane
+			for (; p + 32 <= end; p += 32)
+			{
+				__m256i lo = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i*)p));
+				__m256i hi = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i*)(p + 16)));
+				__m256i quad = _mm256_add_epi16(lo, hi);
+				acc = _mm256_add_epi32(acc, _mm256_cvtepu16_epi32(_mm256_castsi256_si128(quad)));
+				acc = _mm256_add_epi32(acc, _mm256_cvtepu16_epi32(_mm256_extracti128_si256(quad, 1)));
+			}
+
+			// each 128 bit lane holds one pixel's sums
+			__m128i acc128 = _mm_add_epi32(_mm256_castsi256_si128(acc), _mm256_extracti128_si256(acc, 1));
+
+			for (; p < end; p += 4)
+			{
+				guint32 value;
+				memcpy(&value, p, 4);
+				acc128 = _mm_add_epi32(acc128, _mm_cvtepu8_epi32(_mm_cvtsi32_si128(value)));
+			}
+
+			__m128i sum = _mm_loadu_si128((const __m128i*)(sums + 4 * i));
+			_mm_storeu_si128((__m128i*)(sums + 4 * i), _mm_add_epi32(sum, acc128));
+		}
+	}
+#endif
+
+	static AccumulateFunc mAccumulate = nullptr;
+	static const char* mImplementation = "scalar";
+
+	static void pickImplementation()
+	{
+		mAccumulate = accumulateScalar;
+
+#ifdef SCALER_X86
+		__builtin_cpu_init();
+
+		if (__builtin_cpu_supports("avx2"))
+		{
+			mAccumulate = accumulateAVX2;
+			mImplementation = "AVX2";
+		}
+		else if (__builtin_cpu_supports("sse2"))
+		{
+			mAccumulate = accumulateSSE2;
+			mImplementation = "SSE2";
+		}
+#endif
+	}
+
+	static inline guint32 average(guint32 sum, guint32 count)
+	{
+		return (sum + count / 2) / count;
+	}
+
+	static inline guint32 packPixel(const guint32* sums, guint32 count, Format format)
+	{
+		guint32 pixel;
+		guint8* bytes = (guint8*)&pixel;
+
+		switch (format)
+		{
+		case FORMAT_ARGB32:
+		case FORMAT_RGB24:
+			// same memory order in and out
+			for (int c = 0; c < 4; ++c)
+				bytes[c] = average(sums[c], count);
+			return format == FORMAT_RGB24 ? pixel | 0xff000000 : pixel;
+
+		case FORMAT_RGBA:
+		{
+			// averaged before premultiplying, which only shows along translucent edges
+			guint32 a = average(sums[3], count);
+			guint32 r = average(sums[0], count) * a / 255;
+			guint32 g = average(sums[1], count) * a / 255;
+			guint32 b = average(sums[2], count) * a / 255;
+			return a << 24 | r << 16 | g << 8 | b;
+		}
+
+		default:
+			return 0xff000000 | average(sums[0], count) << 16 | average(sums[1], count) << 8 | average(sums[2], count);
+		}
+	}
+
+	void scaleToFit(const guint8* pixels, Format format, int width, int height, int stride, cairo_surface_t* target)
+	{
+		cairo_surface_flush(target);
+
+		guint8* data = cairo_image_surface_get_data(target);
+		int targetWidth = cairo_image_surface_get_width(target);
+		int targetHeight = cairo_image_surface_get_height(target);
+		int targetStride = cairo_image_surface_get_stride(target);
+
+		memset(data, 0, (size_t)targetStride * targetHeight);
+
+		if (width <= 0 || height <= 0 || targetWidth <= 0 || targetHeight <= 0)
+		{
+			cairo_surface_mark_dirty(target);
+			return;
+		}
+
+		if (mAccumulate == nullptr)
+			pickImplementation();
+
+		double ratio = MIN((double)targetWidth / width, (double)targetHeight / height);
+		ratio = MIN(ratio, 1.0);
+
+		int thumbWidth = CLAMP((int)(width * ratio), 1, targetWidth);
+		int thumbHeight = CLAMP((int)(height * ratio), 1, targetHeight);
+		int xOffset = (targetWidth - thumbWidth) / 2;
+		int yOffset = (targetHeight - thumbHeight) / 2;
+
+		std::vector<int> bounds(thumbWidth + 1);
+		for (int i = 0; i <= thumbWidth; ++i)
+			bounds[i] = (gint64)i * width / thumbWidth;
+
+		AccumulateFunc accumulate = format == FORMAT_RGB ? accumulateRGB : mAccumulate;
+		std::vector<guint32> sums(4 * thumbWidth);
+
+		for (int y = 0; y < thumbHeight; ++y)
+		{
+			int y0 = (gint64)y * height / thumbHeight;
+			int y1 = (gint64)(y + 1) * height / thumbHeight;
+
+			std::fill(sums.begin(), sums.end(), 0);
+
+			for (int sy = y0; sy < y1; ++sy)
+				accumulate(pixels + (size_t)sy * stride, bounds.data(), thumbWidth, sums.data());
+
+			guint32* out = (guint32*)(data + (size_t)(yOffset + y) * targetStride) + xOffset;
+
+			for (int x = 0; x < thumbWidth; ++x)
+				out[x] = packPixel(&sums[4 * x], (guint32)(bounds[x + 1] - bounds[x]) * (y1 - y0), format);
+		}
+
+		cairo_surface_mark_dirty(target);
+	}
+
+	const char* implementation()
+	{
+		if (mAccumulate == nullptr)
+			pickImplementation();
+
+		return mImplementation;
+	}
+} // namespace Scaler
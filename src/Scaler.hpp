@@ -0,0 +1,43 @@
+/*
+ * Copyright (c) 2019-2020 Nicolas Szabo <nszabo@vivaldi.net>
+ * Copyright (c) 2020-2021 David Keogh <davidtkeogh@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SCALER_HPP
+#define SCALER_HPP
+
+#include <gtk/gtk.h>
+
+// Single pass area-averaging downscaler for window previews, vectorized where the CPU allows.
+namespace Scaler
+{
+	enum Format
+	{
+		FORMAT_ARGB32, // cairo ARGB32, premultiplied
+		FORMAT_RGB24, // cairo RGB24, the padding byte is ignored
+		FORMAT_RGBA, // GdkPixbuf with alpha, not premultiplied
+		FORMAT_RGB, // GdkPixbuf without alpha
+	};
+
+	// Shrinks the source image into the ARGB32 `target` image surface, keeping its aspect ratio
+	// and centering it. The rest of the target is cleared. Images are never scaled up.
+	void scaleToFit(const guint8* pixels, Format format, int width, int height, int stride, cairo_surface_t* target);
+
+	// Name of the code path picked for this CPU, for debug output
+	const char* implementation();
+} // namespace Scaler
+
+#endif // SCALER_HPP
@@ -19,12 +19,40 @@
 #include "Settings.hpp"
 #include "Hotkeys.hpp"
 #include "LauncherEntry.hpp"
+#include "PreviewPrefetch.hpp"
+#include "Trace.hpp"
 
 namespace Settings
 {
 	Store::AutoPtr<gchar> mPath;
 	Store::AutoPtr<GKeyFile> mFile;
 
+	struct FileWrite
+	{
+		gchar* path;
+		gchar* data;
+		gsize length;
+	};
+
+	// One thread writes the file, in order, the main loop only serializes the key file
+	GThreadPool* mWriter = nullptr;
+
+	static void writeFile(gpointer data, gpointer)
+	{
+		FileWrite* write = (FileWrite*)data;
+		GError* error = nullptr;
+
+		if (!g_file_set_contents(write->path, write->data, write->length, &error))
+		{
+			g_warning("Unable to save the settings: %s", error->message);
+			g_error_free(error);
+		}
+
+		g_free(write->path);
+		g_free(write->data);
+		g_free(write);
+	}
+
 	State<bool> forceIconSize;
 	State<int> iconSize;
 
@@ -53,6 +81,12 @@ namespace Settings
 	State<int> previewWidth;
 	State<int> previewHeight;
 	State<int> previewSleep;
+	State<int> previewMaxFps;
+	State<int> previewCacheSize;
+	State<int> previewPrefetch;
+	State<bool> disableIconCache;
+	State<bool> lightweightButtons;
+	State<int> releaseMenuItems;
 
 	void init()
 	{
@@ -84,6 +118,7 @@ namespace Settings
 				Dock::mGroups.forEach([](std::pair<std::shared_ptr<AppInfo>, std::shared_ptr<Group>> g) -> void {
 					g.second->mGroupMenu.showPreviewsChanged();
 				});
+				PreviewPrefetch::settingsChanged();
 			});
 
 		intValue = g_key_file_get_integer(file, "user", "previewWidth", nullptr);
@@ -325,10 +360,64 @@ namespace Settings
 				g_key_file_set_integer(mFile.get(), "user", "previewSleep", _previewSleep);
 				saveFile();
 			});
+
+		previewMaxFps.setup(g_key_file_get_integer(file, "user", "previewMaxFps", nullptr),
+			[](int _previewMaxFps) -> void {
+				g_key_file_set_integer(mFile.get(), "user", "previewMaxFps", _previewMaxFps);
+				saveFile();
+			});
+
+		previewCacheSize.setup(g_key_file_get_integer(file, "user", "previewCacheSize", nullptr),
+			[](int _previewCacheSize) -> void {
+				g_key_file_set_integer(mFile.get(), "user", "previewCacheSize", _previewCacheSize);
+				saveFile();
+			});
+
+		previewPrefetch.setup(g_key_file_get_integer(file, "user", "previewPrefetch", nullptr),
+			[](int _previewPrefetch) -> void {
+				g_key_file_set_integer(mFile.get(), "user", "previewPrefetch", _previewPrefetch);
+				saveFile();
+
+				PreviewPrefetch::settingsChanged();
+			});
+
+		disableIconCache.setup(g_key_file_get_boolean(file, "user", "disableIconCache", nullptr),
+			[](bool _disableIconCache) -> void {
+				g_key_file_set_boolean(mFile.get(), "user", "disableIconCache", _disableIconCache);
+				saveFile();
+
+				Dock::onPanelResize();
+			});
+
+		lightweightButtons.setup(g_key_file_get_boolean(file, "user", "lightweightButtons", nullptr),
+			[](bool _lightweightButtons) -> void {
+				g_key_file_set_boolean(mFile.get(), "user", "lightweightButtons", _lightweightButtons);
+				saveFile();
+
+				// buttons pick their widget layout when they are built
+				Dock::drawGroups();
+			});
+
+		releaseMenuItems.setup(g_key_file_get_integer(file, "user", "releaseMenuItems", nullptr),
+			[](int _releaseMenuItems) -> void {
+				g_key_file_set_integer(mFile.get(), "user", "releaseMenuItems", _releaseMenuItems);
+				saveFile();
+			});
 	}
 
 	void finalize()
 	{
+		// writes still running go first, and one may still be waiting in the job queue
+		if (mWriter != nullptr)
+			g_thread_pool_free(mWriter, false, true);
+		mWriter = nullptr;
+
+		if (Help::Gtk::isJobQueued(&mFile))
+		{
+			Help::Gtk::cancelJob(&mFile);
+			g_key_file_save_to_file(mFile.get(), mPath.get(), nullptr);
+		}
+
 		mPath.reset();
 		mFile.reset();
 		indicatorColor.get().reset();
@@ -338,6 +427,23 @@ namespace Settings
 
 	void saveFile()
 	{
-		g_key_file_save_to_file(mFile.get(), mPath.get(), nullptr);
+		// settings often change in bursts, they are written once the burst is over
+		Help::Gtk::queueJob(&mFile, Help::Gtk::JOB_LOW, []() {
+			TRACE_SPAN("Settings::saveFile");
+
+			if (mWriter == nullptr)
+				mWriter = g_thread_pool_new(writeFile, nullptr, 1, false, nullptr);
+
+			FileWrite* fileWrite = g_new(FileWrite, 1);
+			fileWrite->path = g_strdup(mPath.get());
+			fileWrite->data = g_key_file_to_data(mFile.get(), &fileWrite->length, nullptr);
+
+			if (mWriter == nullptr)
+				writeFile(fileWrite, nullptr);
+			else
+				g_thread_pool_push(mWriter, fileWrite, nullptr);
+
+			return false;
+		});
 	}
 } // namespace Settings
@@ -72,6 +72,12 @@ namespace Settings
 	// HIDDEN SETTINGS:
 	extern State<int> dockSize;
 	extern State<int> previewSleep;
+	extern State<int> previewMaxFps;
+	extern State<int> previewCacheSize; // MiB
+	extern State<int> previewPrefetch; // recent windows, 0 disables prefetching
+	extern State<bool> disableIconCache;
+	extern State<bool> lightweightButtons;
+	extern State<int> releaseMenuItems; // seconds after a popup closes, 0 keeps the items
 }; // namespace Settings
 
 #endif // SETTINGS_HPP
@@ -117,6 +117,8 @@ namespace Store
 
 		void clear() { mMap.clear(); }
 
+		void swap(Map& other) { mMap.swap(other.mMap); }
+
 	private:
 		std::map<const K, V> mMap;
 	};
@@ -17,44 +17,118 @@
  */
 
 #include "Theme.hpp"
+#include "Trace.hpp"
+
+static GtkCssProvider* mCssProvider = nullptr;
+static std::size_t mCssHash = 0;
+static uint mCssReloads = 0;
+static uint mCssReloadsSkipped = 0;
+static Help::Gtk::Idle mLoadIdle;
+
+static GtkCssProvider* mLauncherCountCssProvider = nullptr;
+static int mLauncherCountPanelSize = -1;
 
 void Theme::init()
 {
+	// "changed" is emitted in bursts (and again for our own provider), load once they settle
+	mLoadIdle.setup([]() {
+		load();
+		return false;
+	});
+
 	g_signal_connect(G_OBJECT(gtk_widget_get_style_context(Dock::mBox)), "changed",
-		G_CALLBACK(+[](GtkStyleContext* stylecontext) { load(); }),
+		G_CALLBACK(+[](GtkStyleContext* stylecontext) { mLoadIdle.start(); }),
 		nullptr);
 }
 
+void Theme::finalize()
+{
+	mLoadIdle.stop();
+
+	if (mCssProvider != nullptr)
+	{
+		gtk_style_context_remove_provider_for_screen(gdk_screen_get_default(), GTK_STYLE_PROVIDER(mCssProvider));
+		g_clear_object(&mCssProvider);
+	}
+
+	mCssHash = 0;
+	mCssReloads = mCssReloadsSkipped = 0;
+
+	g_clear_object(&mLauncherCountCssProvider);
+	mLauncherCountPanelSize = -1;
+}
+
+GtkCssProvider* Theme::getLauncherCountProvider()
+{
+	if (mLauncherCountCssProvider == nullptr)
+		mLauncherCountCssProvider = gtk_css_provider_new();
+
+	return mLauncherCountCssProvider;
+}
+
+void Theme::updateLauncherCountStyle(int panelSize)
+{
+	if (panelSize == mLauncherCountPanelSize)
+		return;
+
+	mLauncherCountPanelSize = panelSize;
+
+	// The badge's current proportions look right on a 56 px panel. Scale all of its
+	// dimensions from that baseline, but limit growth to 125% so it does not dominate
+	// large panels and keep a 60% floor so the count remains legible on very small ones.
+	const double launcherCountScale = CLAMP(panelSize / 56.0, 0.6, 1.25);
+	const int launcherCountFontSize = round(100 * launcherCountScale);
+	const int launcherCountMinWidth = round(12 * launcherCountScale);
+	const int launcherCountVerticalPadding = std::max(1, (int)round(launcherCountScale));
+	const int launcherCountHorizontalPadding = round(4 * launcherCountScale);
+	const int launcherCountMargin = std::max(1, (int)round(launcherCountScale));
+	gchar* launcherCountCss = g_strdup_printf(
+		".launcher_count { min-width: %dpx; font-size: %d%%; padding: %dpx %dpx; margin: %dpx; }",
+		launcherCountMinWidth, launcherCountFontSize, launcherCountVerticalPadding,
+		launcherCountHorizontalPadding, launcherCountMargin);
+	gtk_css_provider_load_from_data(getLauncherCountProvider(), launcherCountCss, -1, nullptr);
+	g_free(launcherCountCss);
+}
+
 void Theme::load()
 {
-	GtkCssProvider* css_provider = gtk_css_provider_new();
+	TRACE_SPAN("Theme::load");
+	gint64 start = g_get_monotonic_time();
 	std::string css = get_theme_colors();
 	css += LAUNCHER_COUNT_THEME;
 	gchar* filename = xfce_resource_lookup(XFCE_RESOURCE_CONFIG, "xfce4-docklike-plugin/gtk.css");
+	gchar* contents = nullptr;
+	gsize length = 0;
 
-	if (filename != nullptr && g_file_test(filename, G_FILE_TEST_IS_REGULAR))
-	{
-		FILE* f = fopen(filename, "r");
-
-		if (f != nullptr)
-		{
-			int read_char;
-			while ((read_char = getc(f)) != EOF)
-				css += read_char;
-			fclose(f);
-		}
-		else // Empty file
-			css += DEFAULT_THEME;
-	}
+	if (filename != nullptr && g_file_get_contents(filename, &contents, &length, nullptr))
+		css.append(contents, length);
 	else // No file
 		css += DEFAULT_THEME;
 
-	if (gtk_css_provider_load_from_data(css_provider, css.c_str(), -1, nullptr))
+	g_free(contents);
+	g_free(filename);
+
+	std::size_t hash = std::hash<std::string>()(css);
+	if (mCssProvider != nullptr && hash == mCssHash)
+	{
+		++mCssReloadsSkipped;
+		return;
+	}
+
+	if (mCssProvider == nullptr)
+	{
+		mCssProvider = gtk_css_provider_new();
 		gtk_style_context_add_provider_for_screen(gdk_screen_get_default(),
-			GTK_STYLE_PROVIDER(css_provider), GTK_STYLE_PROVIDER_PRIORITY_APPLICATION);
+			GTK_STYLE_PROVIDER(mCssProvider), GTK_STYLE_PROVIDER_PRIORITY_APPLICATION);
+	}
 
-	g_free(filename);
-	g_object_unref(css_provider);
+	// Remember the hash even if parsing fails: loading emits "changed" again, which would loop
+	gtk_css_provider_load_from_data(mCssProvider, css.c_str(), -1, nullptr);
+	mCssHash = hash;
+
+	++mCssReloads;
+	g_debug("Theme CSS reloaded in %" G_GINT64_FORMAT " us (%u reloads, %u unchanged skipped)",
+		g_get_monotonic_time() - start, mCssReloads, mCssReloadsSkipped);
 }
 
 std::string Theme::get_theme_colors()
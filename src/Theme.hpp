@@ -20,6 +20,7 @@
 #define THEME_HPP
 
 #define DEFAULT_THEME ".xfce-docklike-window .menu { margin: 0px; padding: 0px; border: 0px; background-color: @menu_bgcolor; }\n" \
+					  ".xfce-docklike-window viewport { border: 0px; background: none; }\n"                                        \
 					  ".xfce-docklike-window .menu_item grid { margin: 0px; padding:4px; }\n"                                      \
 					  ".xfce-docklike-window .menu_item .preview { margin:2px 0px }\n"                                             \
 					  ".xfce-docklike-window .hover_menu_item { background-color: alpha(@menu_item_color_hover, 0.2); }\n";
@@ -43,8 +44,13 @@
 namespace Theme
 {
 	void init();
+	void finalize();
 	void load();
 	std::string get_theme_colors();
+
+	// Shared by every group's launcher count badge, reloaded once per panel size change
+	GtkCssProvider* getLauncherCountProvider();
+	void updateLauncherCountStyle(int panelSize);
 } // namespace Theme
 
 #endif // THEME_HPP
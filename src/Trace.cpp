@@ -0,0 +1,163 @@
+/*
+ * Copyright (c) 2019-2020 Nicolas Szabo <nszabo@vivaldi.net>
+ * Copyright (c) 2020-2021 David Keogh <davidtkeogh@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "Trace.hpp"
+
+#ifdef ENABLE_TRACE
+
+#include "Helpers.hpp"
+#include "Plugin.hpp"
+
+#include <unistd.h>
+
+#include <atomic>
+
+namespace Trace
+{
+	// a power of two, about 20 s of a busy dock
+	const guint mCapacity = 1 << 15;
+
+	// A slot's sequence is odd while it is written, readers skip it then
+	struct Event
+	{
+		std::atomic<guint> sequence;
+		const char* name;
+		int line;
+		guint thread;
+		gint64 start;
+		gint64 duration;
+	};
+
+	std::atomic<bool> mRecording(false);
+	std::atomic<Event*> mEvents(nullptr);
+	std::atomic<guint> mNext(0);
+	std::atomic<guint> mLastThread(0);
+
+	static guint threadId()
+	{
+		static thread_local guint id = ++mLastThread;
+		return id;
+	}
+
+	void finalize()
+	{
+		mRecording.store(false);
+		delete[] mEvents.exchange(nullptr);
+		mNext.store(0);
+	}
+
+	void setRecording(bool recording)
+	{
+		if (recording && mEvents.load() == nullptr)
+			mEvents.store(new Event[mCapacity]());
+
+		mRecording.store(recording, std::memory_order_release);
+		g_message("Docklike trace recording %s", recording ? "started" : "stopped");
+	}
+
+	bool isRecording()
+	{
+		return mRecording.load(std::memory_order_relaxed);
+	}
+
+	void complete(const char* name, int line, gint64 start, gint64 duration)
+	{
+		if (!mRecording.load(std::memory_order_acquire))
+			return;
+
+		guint index = mNext.fetch_add(1, std::memory_order_relaxed);
+		Event& event = mEvents.load(std::memory_order_relaxed)[index & (mCapacity - 1)];
+
+		event.sequence.store(index * 2 + 1, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_release);
+		event.name = name;
+		event.line = line;
+		event.thread = threadId();
+		event.start = start;
+		event.duration = duration;
+		event.sequence.store(index * 2 + 2, std::memory_order_release);
+	}
+
+	void dump(std::string path)
+	{
+		Event* events = mEvents.load();
+
+		if (path.empty())
+		{
+			gchar* basename = g_strdup_printf("trace-%d.json", xfce_panel_plugin_get_unique_id(Plugin::mXfPlugin));
+			gchar* filename = g_build_filename(g_get_user_cache_dir(), "xfce4-docklike-plugin", basename, nullptr);
+			path = filename;
+			g_free(filename);
+			g_free(basename);
+		}
+
+		std::string json = "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+		guint end = mNext.load(std::memory_order_acquire);
+		guint begin = end > mCapacity ? end - mCapacity : 0;
+		bool first = true;
+
+		for (guint index = begin; events != nullptr && index != end; ++index)
+		{
+			Event& event = events[index & (mCapacity - 1)];
+			Event copy;
+
+			// recorders may be lapping us, what they overwrite is dropped
+			guint sequence = event.sequence.load(std::memory_order_acquire);
+			if (sequence != index * 2 + 2)
+				continue;
+
+			copy.name = event.name;
+			copy.line = event.line;
+			copy.thread = event.thread;
+			copy.start = event.start;
+			copy.duration = event.duration;
+
+			std::atomic_thread_fence(std::memory_order_acquire);
+			if (event.sequence.load(std::memory_order_relaxed) != sequence)
+				continue;
+
+			std::string name = copy.line > 0 ? Help::String::pathBasename(copy.name) + ":" + std::to_string(copy.line) : copy.name;
+			gchar* escaped = g_strescape(name.c_str(), nullptr);
+			gchar* entry = g_strdup_printf("%s{\"name\":\"%s\",\"ph\":\"X\",\"pid\":%d,\"tid\":%u,\"ts\":%" G_GINT64_FORMAT ",\"dur\":%" G_GINT64_FORMAT "}",
+				first ? "" : ",\n", escaped, (int)getpid(), copy.thread, copy.start, copy.duration);
+
+			json += entry;
+			first = false;
+			g_free(entry);
+			g_free(escaped);
+		}
+
+		json += "]}\n";
+
+		gchar* dir = g_path_get_dirname(path.c_str());
+		GError* error = nullptr;
+
+		g_mkdir_with_parents(dir, 0700);
+		g_free(dir);
+
+		if (g_file_set_contents(path.c_str(), json.data(), json.size(), &error))
+			g_message("Docklike trace written to '%s'", path.c_str());
+		else
+		{
+			g_warning("Failed to write trace file '%s': %s", path.c_str(), error->message);
+			g_error_free(error);
+		}
+	}
+} // namespace Trace
+
+#endif // ENABLE_TRACE
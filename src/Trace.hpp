@@ -0,0 +1,69 @@
+/*
+ * Copyright (c) 2019-2020 Nicolas Szabo <nszabo@vivaldi.net>
+ * Copyright (c) 2020-2021 David Keogh <davidtkeogh@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef TRACE_HPP
+#define TRACE_HPP
+
+// Flight recorder: the last spans of work the plugin did, kept in memory while recording is
+// on and written out as Chrome trace event JSON on request. Only built with the "trace"
+// option, TRACE_SPAN() expands to nothing otherwise.
+
+#ifdef ENABLE_TRACE
+
+#include <glib.h>
+
+#include <string>
+
+namespace Trace
+{
+	void finalize();
+
+	void setRecording(bool recording);
+	bool isRecording();
+
+	// A span that ended just now, named by `name`, or by `name`:`line` for a source file
+	void complete(const char* name, int line, gint64 start, gint64 duration);
+
+	// Writes the recorded spans to `path`, or to the user cache directory if it is empty
+	void dump(std::string path);
+
+	class Span
+	{
+	public:
+		explicit Span(const char* name) : mName(name), mStart(isRecording() ? g_get_monotonic_time() : 0) {}
+		~Span()
+		{
+			if (mStart != 0)
+				complete(mName, 0, mStart, g_get_monotonic_time() - mStart);
+		}
+
+	private:
+		const char* mName;
+		gint64 mStart;
+	};
+} // namespace Trace
+
+#define TRACE_SPAN(name) Trace::Span G_PASTE(traceSpan, __LINE__)(name)
+
+#else
+
+#define TRACE_SPAN(name)
+
+#endif // ENABLE_TRACE
+
+#endif // TRACE_HPP
@@ -0,0 +1,695 @@
+/*
+ * Copyright (c) 2019-2020 Nicolas Szabo <nszabo@vivaldi.net>
+ * Copyright (c) 2020-2021 David Keogh <davidtkeogh@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifdef ENABLE_X11
+#include <X11/Xlib.h>
+#include <gdk/gdkx.h>
+#include <libxfce4windowing/xfw-x11.h>
+#include <sys/socket.h>
+#ifdef HAVE_XSHM
+#include <X11/extensions/XShm.h>
+#include <sys/ipc.h>
+#include <sys/shm.h>
+#endif
+#ifdef HAVE_XCOMPOSITE
+#include <X11/extensions/Xcomposite.h>
+#endif
+#ifdef HAVE_XDAMAGE
+#include <X11/extensions/Xdamage.h>
+#endif
+#ifdef HAVE_XRENDER
+#include <X11/extensions/Xrender.h>
+#endif
+#endif
+
+#include "Plugin.hpp"
+#include "WindowCapture.hpp"
+
+#include <map>
+#include <set>
+#include <vector>
+
+namespace WindowCapture
+{
+#ifdef ENABLE_X11
+	enum Mode
+	{
+		MODE_NONE, // gdk_pixbuf_get_from_window, visible parts only
+		MODE_SHM, // full size read through shared memory, scaled here
+		MODE_RENDER, // scaled by the server, only the thumbnail is read
+	};
+
+	Mode mMode = MODE_NONE;
+	bool mComposite = false;
+	bool mRender = false;
+	// windows we redirected ourselves, only done without a compositing manager
+	std::set<Window> mRedirected;
+	// redirected ones whose pixmap the client has not painted since, it holds what was visible
+	std::set<Window> mUnpainted;
+
+#ifdef HAVE_XSHM
+	struct Segment
+	{
+		XShmSegmentInfo info;
+		size_t size;
+		bool busy;
+	};
+
+	// Segments are kept around and grown to the largest window seen, since attaching
+	// a new segment costs about as much as the capture itself. A segment stays busy
+	// while its frame is being scaled, so a few are needed to keep the workers fed.
+	std::vector<Segment*> mSegments;
+	const size_t mMaxSegments = 4;
+#endif
+
+	bool mDamage = false;
+
+#ifdef HAVE_XDAMAGE
+	struct Watch
+	{
+		Damage damage;
+		std::function<void()> onDamage;
+	};
+
+	int mDamageEventBase = 0;
+	std::map<Window, Watch> mWatches;
+#endif
+
+	uint mCaptures = 0;
+	uint mFallbacks = 0;
+	guint64 mBytesCopied = 0;
+	guint64 mBytesFullSize = 0;
+	gint64 mCaptureTime = 0;
+
+	static const char* modeName(Mode mode)
+	{
+		switch (mode)
+		{
+		case MODE_SHM:
+			return "MIT-SHM";
+		case MODE_RENDER:
+			return "XRender";
+		default:
+			return "GDK";
+		}
+	}
+
+	// Anything but a unix socket means the pixels travel over the network
+	static bool isLocalDisplay(Display* dpy)
+	{
+		struct sockaddr_storage address;
+		socklen_t length = sizeof(address);
+
+		if (getsockname(ConnectionNumber(dpy), (struct sockaddr*)&address, &length) != 0)
+			return false;
+
+		return address.ss_family == AF_UNIX;
+	}
+
+#ifdef HAVE_XSHM
+	static void detachSegment(Display* dpy, Segment* segment)
+	{
+		if (segment->size == 0)
+			return;
+
+		XShmDetach(dpy, &segment->info);
+		XSync(dpy, false);
+		shmdt(segment->info.shmaddr);
+
+		segment->info = {};
+		segment->size = 0;
+	}
+
+	static bool attachSegment(Display* dpy, Segment* segment, size_t size)
+	{
+		int shmid = shmget(IPC_PRIVATE, size, IPC_CREAT | 0600);
+		if (shmid < 0)
+			return false;
+
+		char* addr = (char*)shmat(shmid, nullptr, 0);
+		if (addr == (char*)-1)
+		{
+			shmctl(shmid, IPC_RMID, nullptr);
+			return false;
+		}
+
+		segment->info.shmid = shmid;
+		segment->info.shmaddr = addr;
+		segment->info.readOnly = false;
+
+		gdk_x11_display_error_trap_push(Plugin::mDisplay);
+		XShmAttach(dpy, &segment->info);
+		XSync(dpy, false);
+		bool attached = gdk_x11_display_error_trap_pop(Plugin::mDisplay) == 0;
+
+		// the segment stays alive until both sides detach, even if we crash
+		shmctl(shmid, IPC_RMID, nullptr);
+
+		if (!attached)
+		{
+			// the server can't reach our memory after all, let it do the scaling instead
+			shmdt(addr);
+			segment->info = {};
+			mMode = mRender ? MODE_RENDER : MODE_NONE;
+			g_debug("Window capture: MIT-SHM attach failed, switching to %s", modeName(mMode));
+			return false;
+		}
+
+		segment->size = size;
+		return true;
+	}
+
+	// Returns an idle segment of at least `size` bytes, or nullptr when all of them are in use
+	static Segment* reserveSegment(Display* dpy, size_t size)
+	{
+		Segment* segment = nullptr;
+
+		for (Segment* candidate : mSegments)
+			if (!candidate->busy && (segment == nullptr || candidate->size > segment->size))
+				segment = candidate;
+
+		if (segment == nullptr)
+		{
+			if (mSegments.size() >= mMaxSegments)
+				return nullptr;
+
+			segment = new Segment();
+			mSegments.push_back(segment);
+		}
+
+		if (segment->size < size)
+		{
+			detachSegment(dpy, segment);
+			if (!attachSegment(dpy, segment, size))
+				return nullptr;
+		}
+
+		segment->busy = true;
+		return segment;
+	}
+#endif
+
+#if defined(HAVE_XSHM) || defined(HAVE_XRENDER)
+	// Whether the image data is laid out the way cairo stores pixels natively.
+	// Images of pixmaps carry no masks, these are read back from the standard ARGB32 format.
+	static bool isNativeImage(XImage* image)
+	{
+		if (image->bits_per_pixel != 32 || image->byte_order != (G_BYTE_ORDER == G_LITTLE_ENDIAN ? LSBFirst : MSBFirst))
+			return false;
+
+		return image->red_mask == 0
+			|| (image->red_mask == 0xff0000 && image->green_mask == 0x00ff00 && image->blue_mask == 0x0000ff);
+	}
+#endif
+
+#ifdef HAVE_XRENDER
+	static void fitSize(int sourceWidth, int sourceHeight, int width, int height, int* fitWidth, int* fitHeight)
+	{
+		double ratio = MIN((double)width / sourceWidth, (double)height / sourceHeight);
+		ratio = MIN(ratio, 1.0);
+
+		*fitWidth = MAX(1, sourceWidth * ratio);
+		*fitHeight = MAX(1, sourceHeight * ratio);
+	}
+#endif
+
+#ifdef HAVE_XSHM
+	static bool acquireShm(Display* dpy, Drawable drawable, const XWindowAttributes& attributes, Frame* frame)
+	{
+		XImage* image = XShmCreateImage(dpy, attributes.visual, attributes.depth, ZPixmap, nullptr, nullptr,
+			attributes.width, attributes.height);
+
+		if (image == nullptr)
+			return false;
+
+		size_t size = (size_t)image->bytes_per_line * image->height;
+		Segment* segment = reserveSegment(dpy, size);
+		bool acquired = false;
+
+		if (segment != nullptr)
+		{
+			image->data = segment->info.shmaddr;
+			image->obdata = (char*)&segment->info;
+
+			if (XShmGetImage(dpy, drawable, image, 0, 0, AllPlanes) && isNativeImage(image))
+			{
+				frame->pixels = (const guint8*)segment->info.shmaddr;
+				frame->format = attributes.depth == 32 ? Scaler::FORMAT_ARGB32 : Scaler::FORMAT_RGB24;
+				frame->width = image->width;
+				frame->height = image->height;
+				frame->stride = image->bytes_per_line;
+				frame->owner = segment;
+				frame->release = [](gpointer owner) { ((Segment*)owner)->busy = false; };
+				acquired = true;
+			}
+			else
+				segment->busy = false;
+		}
+
+		// the data belongs to the segment, not to the image
+		image->data = nullptr;
+		XDestroyImage(image);
+
+		return acquired;
+	}
+#endif
+
+#ifdef HAVE_XRENDER
+	// Scales *picture from *width x *height to stepWidth x stepHeight into a new ARGB32 picture,
+	// which replaces it. The previous step is freed, the window's own picture is left to the caller.
+	static void renderStep(Display* dpy, Drawable drawable, XRenderPictFormat* format,
+		Picture* picture, Pixmap* pixmap, int* width, int* height, int stepWidth, int stepHeight)
+	{
+		// the transform maps destination pixels to source pixels
+		XTransform transform = {{
+			{XDoubleToFixed((double)*width / stepWidth), 0, 0},
+			{0, XDoubleToFixed((double)*height / stepHeight), 0},
+			{0, 0, XDoubleToFixed(1)},
+		}};
+		XRenderSetPictureTransform(dpy, *picture, &transform);
+		XRenderSetPictureFilter(dpy, *picture, FilterGood, nullptr, 0);
+
+		Pixmap stepPixmap = XCreatePixmap(dpy, drawable, stepWidth, stepHeight, 32);
+		Picture step = XRenderCreatePicture(dpy, stepPixmap, format, 0, nullptr);
+		XRenderComposite(dpy, PictOpSrc, *picture, None, step, 0, 0, 0, 0, 0, 0, stepWidth, stepHeight);
+
+		if (*pixmap != None)
+		{
+			XRenderFreePicture(dpy, *picture);
+			XFreePixmap(dpy, *pixmap);
+		}
+
+		*picture = step;
+		*pixmap = stepPixmap;
+		*width = stepWidth;
+		*height = stepHeight;
+	}
+
+	static bool acquireRender(Display* dpy, Drawable drawable, const XWindowAttributes& attributes,
+		int width, int height, Frame* frame)
+	{
+		XRenderPictFormat* sourceFormat = XRenderFindVisualFormat(dpy, attributes.visual);
+		XRenderPictFormat* thumbFormat = XRenderFindStandardFormat(dpy, PictStandardARGB32);
+
+		if (sourceFormat == nullptr || thumbFormat == nullptr)
+			return false;
+
+		int thumbWidth, thumbHeight;
+		fitSize(attributes.width, attributes.height, width, height, &thumbWidth, &thumbHeight);
+
+		// without a composite pixmap, read what is visible of the window and its children
+		XRenderPictureAttributes pictureAttributes = {};
+		pictureAttributes.subwindow_mode = IncludeInferiors;
+		Picture source = XRenderCreatePicture(dpy, drawable, sourceFormat, CPSubwindowMode, &pictureAttributes);
+
+		// The bilinear filter only looks at 2x2 source pixels, and aliases badly when scaling
+		// down 10x or more. At exactly half the size though, each pixel is the mean of its 2x2
+		// source pixels, so the window is halved until the rest is less than half.
+		Picture thumb = source;
+		Pixmap thumbPixmap = None;
+		int currentWidth = attributes.width;
+		int currentHeight = attributes.height;
+
+		while (currentWidth >= thumbWidth * 2 && currentHeight >= thumbHeight * 2)
+			renderStep(dpy, drawable, thumbFormat, &thumb, &thumbPixmap, &currentWidth, &currentHeight,
+				currentWidth / 2, currentHeight / 2);
+
+		renderStep(dpy, drawable, thumbFormat, &thumb, &thumbPixmap, &currentWidth, &currentHeight,
+			thumbWidth, thumbHeight);
+
+		XImage* image = XGetImage(dpy, thumbPixmap, 0, 0, thumbWidth, thumbHeight, AllPlanes, ZPixmap);
+
+		XRenderFreePicture(dpy, thumb);
+		XRenderFreePicture(dpy, source);
+		XFreePixmap(dpy, thumbPixmap);
+
+		if (image == nullptr)
+			return false;
+
+		if (!isNativeImage(image))
+		{
+			XDestroyImage(image);
+			return false;
+		}
+
+		frame->pixels = (const guint8*)image->data;
+		frame->format = Scaler::FORMAT_ARGB32;
+		frame->width = image->width;
+		frame->height = image->height;
+		frame->stride = image->bytes_per_line;
+		frame->owner = image;
+		frame->release = [](gpointer owner) { XDestroyImage((XImage*)owner); };
+
+		return true;
+	}
+#endif
+
+#ifdef HAVE_XCOMPOSITE
+	static void unredirect(Display* dpy, Window xid)
+	{
+		mUnpainted.erase(xid);
+		if (mRedirected.erase(xid) == 0)
+			return;
+
+		// a destroyed window lost its redirection with it, and its XID may be reused already
+		gdk_x11_display_error_trap_push(Plugin::mDisplay);
+		XCompositeUnredirectWindow(dpy, xid, CompositeRedirectAutomatic);
+		gdk_x11_display_error_trap_pop_ignored(Plugin::mDisplay);
+	}
+#endif
+
+#ifdef HAVE_XDAMAGE
+	static GdkFilterReturn filterDamage(GdkXEvent* gdkXEvent, GdkEvent* event, gpointer data)
+	{
+		XEvent* xevent = (XEvent*)gdkXEvent;
+
+		if (xevent->type != mDamageEventBase + XDamageNotify)
+			return GDK_FILTER_CONTINUE;
+
+		// the drawable is the watched window, the damage is only reset by the next capture
+		Window xid = ((XDamageNotifyEvent*)xevent)->drawable;
+		mUnpainted.erase(xid);
+
+		std::map<Window, Watch>::iterator it = mWatches.find(xid);
+		if (it != mWatches.end())
+			it->second.onDamage();
+
+		return GDK_FILTER_REMOVE;
+	}
+#endif
+
+	static bool acquirePixbuf(Window xid, Frame* frame)
+	{
+		GdkWindow* window = gdk_x11_window_foreign_new_for_display(Plugin::mDisplay, xid);
+
+		if (window == nullptr)
+			return false;
+
+		// we're probably not doing anything wrong at our level, but things can go wrong in cairo when
+		// multiple windows are closed and thumbnails are shown (#71), so let's catch X11 errors for it
+		gdk_x11_display_error_trap_push(Plugin::mDisplay);
+		GdkPixbuf* pixbuf = gdk_pixbuf_get_from_window(window, 0, 0, gdk_window_get_width(window), gdk_window_get_height(window));
+		gdk_x11_display_error_trap_pop_ignored(Plugin::mDisplay);
+		g_object_unref(window);
+
+		if (pixbuf == nullptr)
+			return false;
+
+		frame->pixels = gdk_pixbuf_read_pixels(pixbuf);
+		frame->format = gdk_pixbuf_get_has_alpha(pixbuf) ? Scaler::FORMAT_RGBA : Scaler::FORMAT_RGB;
+		frame->width = gdk_pixbuf_get_width(pixbuf);
+		frame->height = gdk_pixbuf_get_height(pixbuf);
+		frame->stride = gdk_pixbuf_get_rowstride(pixbuf);
+		frame->owner = pixbuf;
+		frame->release = g_object_unref;
+
+		return true;
+	}
+#endif
+
+	void init()
+	{
+#ifdef ENABLE_X11
+		if (!GDK_IS_X11_DISPLAY(Plugin::mDisplay))
+			return;
+
+		Display* dpy = GDK_DISPLAY_XDISPLAY(Plugin::mDisplay);
+
+#ifdef HAVE_XCOMPOSITE
+		// XCompositeNameWindowPixmap needs Composite 0.2
+		int eventBase, errorBase, major = 0, minor = 0;
+		mComposite = XCompositeQueryExtension(dpy, &eventBase, &errorBase)
+			&& XCompositeQueryVersion(dpy, &major, &minor)
+			&& (major > 0 || minor >= 2);
+#endif
+
+#ifdef HAVE_XRENDER
+		// picture transforms and filters need Render 0.6
+		int renderEventBase, renderErrorBase, renderMajor = 0, renderMinor = 0;
+		mRender = XRenderQueryExtension(dpy, &renderEventBase, &renderErrorBase)
+			&& XRenderQueryVersion(dpy, &renderMajor, &renderMinor)
+			&& (renderMajor > 0 || renderMinor >= 6);
+#endif
+
+#ifdef HAVE_XDAMAGE
+		int damageErrorBase;
+		mDamage = XDamageQueryExtension(dpy, &mDamageEventBase, &damageErrorBase);
+		if (mDamage)
+			gdk_window_add_filter(nullptr, filterDamage, nullptr);
+#endif
+
+		bool local = isLocalDisplay(dpy);
+
+#ifdef HAVE_XSHM
+		if (local && mComposite && XShmQueryExtension(dpy))
+			mMode = MODE_SHM;
+#endif
+		if (mMode == MODE_NONE && mRender)
+			mMode = MODE_RENDER;
+
+		g_debug("Window capture: %s display, Composite %s, Damage %s, using %s, %s scaler",
+			local ? "local" : "remote", mComposite ? "available" : "missing", mDamage ? "available" : "missing",
+			modeName(mMode), Scaler::implementation());
+#endif
+	}
+
+	void finalize()
+	{
+#ifdef ENABLE_X11
+		if (!GDK_IS_X11_DISPLAY(Plugin::mDisplay))
+			return;
+
+		Display* dpy = GDK_DISPLAY_XDISPLAY(Plugin::mDisplay);
+
+		g_debug("Window capture: %u captures, %" G_GUINT64_FORMAT " bytes copied (%" G_GUINT64_FORMAT
+				" at full size), %" G_GINT64_FORMAT " us spent, %u through GDK instead of %s",
+			mCaptures, mBytesCopied, mBytesFullSize, mCaptureTime, mFallbacks, modeName(mMode));
+
+		// windows that were destroyed in the meantime lost their redirection with them
+		gdk_x11_display_error_trap_push(Plugin::mDisplay);
+#ifdef HAVE_XCOMPOSITE
+		for (Window xid : mRedirected)
+			XCompositeUnredirectWindow(dpy, xid, CompositeRedirectAutomatic);
+#endif
+#ifdef HAVE_XDAMAGE
+		for (auto& watch : mWatches)
+			XDamageDestroy(dpy, watch.second.damage);
+#endif
+		gdk_x11_display_error_trap_pop_ignored(Plugin::mDisplay);
+
+#ifdef HAVE_XDAMAGE
+		if (mDamage)
+			gdk_window_remove_filter(nullptr, filterDamage, nullptr);
+		mWatches.clear();
+#endif
+
+#ifdef HAVE_XSHM
+		for (Segment* segment : mSegments)
+		{
+			detachSegment(dpy, segment);
+			delete segment;
+		}
+		mSegments.clear();
+#endif
+
+		mRedirected.clear();
+		mUnpainted.clear();
+		mMode = MODE_NONE;
+		mComposite = mRender = mDamage = false;
+		mCaptures = mFallbacks = 0;
+		mBytesCopied = mBytesFullSize = 0;
+		mCaptureTime = 0;
+#endif
+	}
+
+	bool acquire(XfwWindow* window, int width, int height, Frame* frame)
+	{
+#ifdef ENABLE_X11
+	// This needs work to survive porting to GTK4 and/or Wayland.
+	// GDK doesn't expose an API to get a foreign window on X11 anymore (so X11 code).
+	// Wayland may never have a public protocol for obtaining a preview of a foreign window,
+	// which goes against its security principles (so private protocol).
+		if (!GDK_IS_X11_DISPLAY(Plugin::mDisplay) || width <= 0 || height <= 0)
+			return false;
+
+		gint64 start = g_get_monotonic_time();
+		Display* dpy = GDK_DISPLAY_XDISPLAY(Plugin::mDisplay);
+		Window xid = xfw_window_x11_get_xid(window);
+		XWindowAttributes attributes;
+		bool acquired = false;
+
+		gdk_x11_display_error_trap_push(Plugin::mDisplay);
+
+		// A compositing manager (the owner of _NET_WM_CM_Sn, as tracked by GDK) keeps every
+		// window in a pixmap already. Without one, an automatic redirection keeps the content of
+		// a previewed window while it is occluded, until the window is unwatched or closed.
+#ifdef HAVE_XCOMPOSITE
+		if (mComposite && !gdk_screen_is_composited(gdk_screen_get_default()) && mRedirected.insert(xid).second)
+		{
+			XCompositeRedirectWindow(dpy, xid, CompositeRedirectAutomatic);
+			mUnpainted.insert(xid);
+		}
+#endif
+
+		// The new pixmap only got the visible parts of the window, the rest is black until the
+		// client repaints, which the first damage event reports. Without a watch for that,
+		// only this capture is left to GDK.
+		bool unpainted = mUnpainted.count(xid) != 0;
+
+#ifdef HAVE_XDAMAGE
+		// reset before reading, so that anything drawn from now on is reported again
+		std::map<Window, Watch>::iterator watch = mWatches.find(xid);
+		if (watch != mWatches.end())
+			XDamageSubtract(dpy, watch->second.damage, None, None);
+		else
+			mUnpainted.erase(xid);
+#else
+		mUnpainted.erase(xid);
+#endif
+
+		if (mMode != MODE_NONE && !unpainted && XGetWindowAttributes(dpy, xid, &attributes) && attributes.map_state == IsViewable)
+		{
+			Pixmap pixmap = None;
+#ifdef HAVE_XCOMPOSITE
+			if (mComposite)
+				pixmap = XCompositeNameWindowPixmap(dpy, xid);
+#endif
+			Drawable drawable = pixmap != None ? pixmap : xid;
+
+#ifdef HAVE_XSHM
+			if (mMode == MODE_SHM)
+				acquired = acquireShm(dpy, drawable, attributes, frame);
+#endif
+
+#ifdef HAVE_XRENDER
+			// also taken when the SHM attach just failed
+			if (!acquired && mMode == MODE_RENDER)
+				acquired = acquireRender(dpy, drawable, attributes, width, height, frame);
+#endif
+
+			if (pixmap != None)
+				XFreePixmap(dpy, pixmap);
+		}
+
+		// the window may have gone away while we were reading it
+		if (gdk_x11_display_error_trap_pop(Plugin::mDisplay) != 0 && acquired)
+		{
+			release(frame);
+			acquired = false;
+		}
+
+		if (acquired)
+		{
+			gint64 elapsed = g_get_monotonic_time() - start;
+			gsize copied = (gsize)frame->stride * frame->height;
+			gsize fullSize = (gsize)attributes.width * attributes.height * 4;
+
+			++mCaptures;
+			mBytesCopied += copied;
+			mBytesFullSize += fullSize;
+			mCaptureTime += elapsed;
+
+			g_debug("Window capture: %dx%d window in %" G_GINT64_FORMAT " us, %" G_GSIZE_FORMAT
+					" bytes copied (%" G_GSIZE_FORMAT " at full size)",
+				attributes.width, attributes.height, elapsed, copied, fullSize);
+		}
+		else
+		{
+			// reads what is visible of the window, better than a blank preview
+			if (mMode != MODE_NONE)
+				++mFallbacks;
+			acquired = acquirePixbuf(xid, frame);
+		}
+
+		return acquired;
+#else
+		return false;
+#endif
+	}
+
+	bool damageAvailable()
+	{
+#ifdef ENABLE_X11
+		return mDamage;
+#else
+		return false;
+#endif
+	}
+
+	void watch(XfwWindow* window, std::function<void()> onDamage)
+	{
+#if defined(ENABLE_X11) && defined(HAVE_XDAMAGE)
+		if (!mDamage)
+			return;
+
+		Display* dpy = GDK_DISPLAY_XDISPLAY(Plugin::mDisplay);
+		Window xid = xfw_window_x11_get_xid(window);
+
+		if (mWatches.find(xid) != mWatches.end())
+			return;
+
+		// one event per change after a capture, no matter how much is drawn in between
+		gdk_x11_display_error_trap_push(Plugin::mDisplay);
+		Damage damage = XDamageCreate(dpy, xid, XDamageReportNonEmpty);
+		if (gdk_x11_display_error_trap_pop(Plugin::mDisplay) == 0)
+			mWatches[xid] = {damage, onDamage};
+#endif
+	}
+
+	void unwatch(XfwWindow* window)
+	{
+#ifdef ENABLE_X11
+		if (!GDK_IS_X11_DISPLAY(Plugin::mDisplay))
+			return;
+
+		Display* dpy = GDK_DISPLAY_XDISPLAY(Plugin::mDisplay);
+		Window xid = xfw_window_x11_get_xid(window);
+		(void)dpy;
+
+#ifdef HAVE_XDAMAGE
+		std::map<Window, Watch>::iterator it = mWatches.find(xid);
+
+		if (it != mWatches.end())
+		{
+			// the damage is gone already if the window was destroyed
+			gdk_x11_display_error_trap_push(Plugin::mDisplay);
+			XDamageDestroy(dpy, it->second.damage);
+			gdk_x11_display_error_trap_pop_ignored(Plugin::mDisplay);
+
+			mWatches.erase(it);
+		}
+#endif
+
+#ifdef HAVE_XCOMPOSITE
+		// nobody looks at it anymore, let the server draw it directly again
+		unredirect(dpy, xid);
+#endif
+		(void)xid;
+#endif
+	}
+
+	void release(Frame* frame)
+	{
+		if (frame->release != nullptr)
+			frame->release(frame->owner);
+
+		frame->owner = nullptr;
+		frame->release = nullptr;
+		frame->pixels = nullptr;
+	}
+} // namespace WindowCapture
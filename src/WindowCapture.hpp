@@ -0,0 +1,65 @@
+/*
+ * Copyright (c) 2019-2020 Nicolas Szabo <nszabo@vivaldi.net>
+ * Copyright (c) 2020-2021 David Keogh <davidtkeogh@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef WINDOW_CAPTURE_HPP
+#define WINDOW_CAPTURE_HPP
+
+#include "Scaler.hpp"
+
+#include <gtk/gtk.h>
+#include <libxfce4windowing/libxfce4windowing.h>
+
+#include <functional>
+
+// Window thumbnails read from the window's XComposite pixmap through an MIT-SHM segment,
+// so that occluded windows can be captured without copying them through the X protocol.
+// Each X extension is optional at build time, without them windows are read through GDK.
+namespace WindowCapture
+{
+	// Pixels of a window as read from the server. They stay valid, and can be read from
+	// any thread, until the frame is released on the main thread.
+	struct Frame
+	{
+		const guint8* pixels;
+		Scaler::Format format;
+		int width;
+		int height;
+		int stride;
+
+		// what backs the pixels: an SHM segment, an XImage or a GdkPixbuf
+		gpointer owner;
+		void (*release)(gpointer owner);
+	};
+
+	void init();
+	void finalize();
+
+	// Reads the window content, shrunk on the server already to fit `width` by `height`
+	// device pixels when the display is remote. Must be called from the main thread.
+	bool acquire(XfwWindow* window, int width, int height, Frame* frame);
+	void release(Frame* frame);
+
+	// XDamage change tracking: `onDamage` runs once the window content changes after
+	// the last capture, and not again before the next one.
+	bool damageAvailable();
+	void watch(XfwWindow* window, std::function<void()> onDamage);
+	// Also ends the redirection of the window, if it was ours. Called when the window closes.
+	void unwatch(XfwWindow* window);
+} // namespace WindowCapture
+
+#endif // WINDOW_CAPTURE_HPP
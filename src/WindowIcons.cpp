@@ -0,0 +1,110 @@
+/*
+ * Copyright (c) 2019-2020 Nicolas Szabo <nszabo@vivaldi.net>
+ * Copyright (c) 2020-2021 David Keogh <davidtkeogh@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "WindowIcons.hpp"
+
+#include <algorithm>
+#include <string>
+#include <unordered_map>
+
+namespace WindowIcons
+{
+	std::unordered_map<std::string, cairo_surface_t*> mSurfaces;
+	cairo_user_data_key_t mKey;
+
+	uint mLookups = 0;
+	uint mShared = 0;
+	size_t mPeakSurfaces = 0;
+	size_t mBytes = 0;
+	size_t mPeakBytes = 0;
+
+	static size_t surfaceSize(cairo_surface_t* surface)
+	{
+		return (size_t)cairo_image_surface_get_stride(surface) * cairo_image_surface_get_height(surface);
+	}
+
+	static std::string contentKey(GdkPixbuf* pixbuf, int scale)
+	{
+		int width = gdk_pixbuf_get_width(pixbuf);
+		int height = gdk_pixbuf_get_height(pixbuf);
+		int rowstride = gdk_pixbuf_get_rowstride(pixbuf);
+		const guchar* pixels = gdk_pixbuf_read_pixels(pixbuf);
+
+		// only the pixels of each row, the padding after them is undefined
+		GChecksum* checksum = g_checksum_new(G_CHECKSUM_SHA1);
+		for (int y = 0; y < height; ++y)
+			g_checksum_update(checksum, pixels + (gsize)y * rowstride, (gssize)width * gdk_pixbuf_get_n_channels(pixbuf));
+
+		gchar* key = g_strdup_printf("%s\n%d\n%d\n%d\n%d", g_checksum_get_string(checksum),
+			width, height, gdk_pixbuf_get_has_alpha(pixbuf), scale);
+		std::string ret = key;
+
+		g_free(key);
+		g_checksum_free(checksum);
+
+		return ret;
+	}
+
+	void finalize()
+	{
+		if (mLookups > 0)
+			g_debug("Window icons: %u lookups, %u shared, %" G_GSIZE_FORMAT " surfaces (%" G_GSIZE_FORMAT " bytes) at peak, %" G_GSIZE_FORMAT " still in use",
+				mLookups, mShared, mPeakSurfaces, mPeakBytes, mSurfaces.size());
+
+		// surfaces still in use remove themselves from the table whenever they go
+		mLookups = mShared = 0;
+		mPeakSurfaces = mPeakBytes = 0;
+	}
+
+	cairo_surface_t* get(GdkPixbuf* pixbuf, int scale)
+	{
+		std::string key = contentKey(pixbuf, scale);
+		++mLookups;
+
+		auto it = mSurfaces.find(key);
+		if (it != mSurfaces.end())
+		{
+			++mShared;
+			return cairo_surface_reference(it->second);
+		}
+
+		cairo_surface_t* surface = gdk_cairo_surface_create_from_pixbuf(pixbuf, scale, nullptr);
+		if (cairo_surface_status(surface) != CAIRO_STATUS_SUCCESS)
+			return surface;
+
+		// the table holds no reference, it follows the surface's lifetime
+		cairo_surface_set_user_data(surface, &mKey, new std::string(key), [](void* data) {
+			std::string* _key = (std::string*)data;
+			auto _it = mSurfaces.find(*_key);
+
+			if (_it != mSurfaces.end())
+			{
+				mBytes -= surfaceSize(_it->second);
+				mSurfaces.erase(_it);
+			}
+			delete _key;
+		});
+
+		mSurfaces.emplace(key, surface);
+		mBytes += surfaceSize(surface);
+		mPeakSurfaces = std::max(mPeakSurfaces, mSurfaces.size());
+		mPeakBytes = std::max(mPeakBytes, mBytes);
+
+		return surface;
+	}
+} // namespace WindowIcons
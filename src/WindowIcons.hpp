@@ -0,0 +1,35 @@
+/*
+ * Copyright (c) 2019-2020 Nicolas Szabo <nszabo@vivaldi.net>
+ * Copyright (c) 2020-2021 David Keogh <davidtkeogh@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef WINDOW_ICONS_HPP
+#define WINDOW_ICONS_HPP
+
+#include <gtk/gtk.h>
+
+// Menu item icons, shared between windows whose icons have the same pixels. The windows of
+// one application nearly always do.
+namespace WindowIcons
+{
+	void finalize();
+
+	// Returns a new reference to the surface for the pixbuf. A surface is dropped from the
+	// table when its last user releases it.
+	cairo_surface_t* get(GdkPixbuf* pixbuf, int scale);
+} // namespace WindowIcons
+
+#endif // WINDOW_ICONS_HPP
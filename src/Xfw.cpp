@@ -17,6 +17,11 @@
  */
 
 #include "Xfw.hpp"
+#include "Audit.hpp"
+#include "PreviewCache.hpp"
+#include "PreviewPrefetch.hpp"
+#include "PreviewScheduler.hpp"
+#include "WindowCapture.hpp"
 
 #include <libxfce4ui/libxfce4ui.h>
 
@@ -102,18 +107,23 @@ namespace Xfw
 
 		g_signal_connect(G_OBJECT(mXfwScreen), "window-opened",
 			G_CALLBACK(+[](XfwScreen* screen, XfwWindow* xfwWindow) {
+				Audit::Scope audit(Audit::KIND_SIGNAL, "xfw window-opened");
 				std::shared_ptr<GroupWindow> newWindow = std::make_shared<GroupWindow>(xfwWindow);
 				mGroupWindows.pushSecond(xfwWindow, newWindow);
 				newWindow->mGroup->updateStyle();
 
 				if (Settings::showPreviews && newWindow->mGroup->mGroupMenu.mVisible)
-					newWindow->mGroupMenuItem->mPreviewTimeout.start();
+					PreviewScheduler::setPriority(newWindow->getMenuItem(), PreviewScheduler::PRIORITY_VISIBLE);
 			}),
 			nullptr);
 
 		g_signal_connect(G_OBJECT(mXfwScreen), "window-closed",
 			G_CALLBACK(+[](XfwScreen* screen, XfwWindow* xfwWindow) {
+				Audit::Scope audit(Audit::KIND_SIGNAL, "xfw window-closed");
 				mGroupWindows.pop(xfwWindow);
+				PreviewCache::remove(xfwWindow);
+				PreviewPrefetch::forget(xfwWindow);
+				WindowCapture::unwatch(xfwWindow);
 				if (xfwWindow == mPreviousActiveWindow)
 					mPreviousActiveWindow = nullptr;
 			}),
@@ -121,11 +131,13 @@ namespace Xfw
 
 		g_signal_connect(G_OBJECT(mXfwScreen), "active-window-changed",
 			G_CALLBACK(+[](XfwScreen* screen, XfwWindow* previousActiveWindow) {
+				Audit::Scope audit(Audit::KIND_SIGNAL, "xfw active-window-changed");
 				XfwWindow* activeXfwWindow = getActiveWindow();
 				if (activeXfwWindow != nullptr)
 				{
 					std::shared_ptr<GroupWindow> activeWindow = mGroupWindows.get(activeXfwWindow);
-					Help::Gtk::cssClassAdd(GTK_WIDGET(activeWindow->mGroupMenuItem->mItem), "active_menu_item");
+					if (activeWindow->mGroupMenuItem != nullptr)
+						Help::Gtk::cssClassAdd(GTK_WIDGET(activeWindow->mGroupMenuItem->mItem), "active_menu_item");
 					gtk_widget_queue_draw(activeWindow->mGroup->mButton);
 				}
 				if (previousActiveWindow != nullptr)
@@ -133,12 +145,14 @@ namespace Xfw
 					std::shared_ptr<GroupWindow> prevWindow = mGroupWindows.get(previousActiveWindow);
 					if (prevWindow)
 					{
-						Help::Gtk::cssClassRemove(GTK_WIDGET(prevWindow->mGroupMenuItem->mItem), "active_menu_item");
+						if (prevWindow->mGroupMenuItem != nullptr)
+							Help::Gtk::cssClassRemove(GTK_WIDGET(prevWindow->mGroupMenuItem->mItem), "active_menu_item");
 						gtk_widget_queue_draw(prevWindow->mGroup->mButton);
 						mPreviousActiveWindow = previousActiveWindow;
 					}
 				}
 				setActiveWindow(previousActiveWindow);
+				PreviewPrefetch::windowActivated(activeXfwWindow, previousActiveWindow);
 			}),
 			nullptr);
 
@@ -151,6 +165,7 @@ namespace Xfw
 				mXfwWorkspaceGroup = XFW_WORKSPACE_GROUP(xfw_workspace_manager_list_workspace_groups(manager)->data);
 				g_signal_connect(G_OBJECT(mXfwWorkspaceGroup), "active-workspace-changed",
 					G_CALLBACK(+[](XfwScreen* screen, XfwWindow* xfwWindow) {
+						Audit::Scope audit(Audit::KIND_SIGNAL, "xfw active-workspace-changed");
 						setVisibleGroups();
 					}),
 					nullptr);
@@ -169,6 +184,7 @@ namespace Xfw
 					mXfwWorkspaceGroup = XFW_WORKSPACE_GROUP(groups->data);
 					g_signal_connect(G_OBJECT(mXfwWorkspaceGroup), "active-workspace-changed",
 						G_CALLBACK(+[](XfwScreen* screen, XfwWindow* xfwWindow) {
+							Audit::Scope audit(Audit::KIND_SIGNAL, "xfw active-workspace-changed");
 							setVisibleGroups();
 						}),
 						nullptr);